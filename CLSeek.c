@@ -72,6 +72,9 @@
 #define _PROGRAMNAME_	"CLSeek"	/* program name */
 #define _PROGRAMVERSION_	"1.10b"	/* program version */
 #define	_ENVVARNAME_	"CLSEEKOPT"	/* environment variable name */
+#define	CLSEEK_EXIT_TIMED_OUT	124	/* --timeout reached, as timeout(1) */
+#define	CLSEEK_EXIT_CANCELLED	130	/* SIGINT/SIGTERM, 128 + SIGINT */
+#define	CLSEEK_EXIT_FOUND_MAX	123	/* # of entries found, capped below the codes above */
 
 #include <stdio.h>
 #ifdef	_MSC_VER
@@ -79,6 +82,8 @@
 #endif	/* _MSC_VER */
 #include <string.h>
 #include <stdlib.h>		// calloc
+#include <limits.h>		// INT_MAX
+#include <errno.h>
 #include <stdint.h>		// uint32_t
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -166,6 +171,21 @@ static char gPathDelimiter =
 uint gEntityAttribute = 0;
 uint gLimitEntry = 0;
 uint gLimitDirLevel = 0;
+uint gThreads = 1;					/* # of threads traversing directories */
+uint gDeviceThreads = 0;			/* threads on one device at a time (0 = all) */
+boolean      gAdaptive = 0;			/* -P# is the most, threads at work tuned as it goes */
+uint         gPrefetch = 0;			/* directories read ahead of the matching (0 = none) */
+boolean      gBreadthFirst = 0;		/* shallow entries first */
+boolean      gUring = 0;			/* stat & open entries through io_uring */
+boolean      gInodeOrder = 0;		/* stat entries in inode order */
+boolean      gFsPolicy = 0;			/* tune the traversal to each file system type */
+boolean      gFollowLinks = 0;		/* follow symbolic links */
+boolean      gOneFileSystem = 0;	/* do not cross mount points */
+boolean      gOrdered = 0;			/* parallel traversal, output in sequential order */
+uint         gTimeout = 0;			/* seconds the job may take (0 = unlimited) */
+time_t       gDeadline = 0;			/* wall clock time the job ends at */
+volatile sig_atomic_t gCancelled = 0;		/* cancellation token, set on SIGINT/SIGTERM */
+int          gInterrupted = 0;		/* DIRINFO_CANCELLED or DIRINFO_TIMED_OUT */
 uint gTotalMatches = 0;
 boolean      gJunkPaths = 0;
 boolean      gRecursive = 0;
@@ -200,6 +220,8 @@ uint gPathNameCriteria = 0;         /* indicates any constraint on pathname or f
 	uint gPathContainsCnt = 0;
 	char **gPathExcludesStr = NULL;
 	uint gPathExcludesCnt = 0;
+	char **gDirExcludesStr = NULL;		/* directory names not to descend into */
+	uint gDirExcludesCnt = 0;
 	char *gFileRegExp   = NULL;
 	struct re_pattern_buffer gFilePatternBuffer = {0};
 	char *gPathRegExp   = NULL;
@@ -209,6 +231,9 @@ uint gTimeStampCriteria = 0;
 	char *gPathOlder    = NULL;
 	struct stat gPathNewerStat;
 	struct stat gPathOlderStat;
+	struct timespec gPathNewerTime;	/* time stamp of gPathNewer (gTimeField) */
+	struct timespec gPathOlderTime;	/* time stamp of gPathOlder (gTimeField) */
+	int gTimeField = DIRINFO_MTIME;	/* time stamp compared by -n, -o, -t */
 	int gTimeDirection	= 0;
 	time_t gTimeRange = 0;
 	time_t gCurrentTime = 0;
@@ -223,6 +248,7 @@ uint gFileNameLengthCriteria = 0;
 	int gNameLengthUpperLimit = 0;	/* when gNameLengthComparisonSetting == SIZE_IN_RANGE */
 	int gNameLengthLowerLimit = 0;	/* when gNameLengthComparisonSetting == SIZE_IN_RANGE */
 uint gPermissionCriteria = 0;
+uint gStatCriteria = 0;				/* any constraint (or output) needs the file status */
 char *gPermissionConstraintStr = NULL;
 #define	MODE_NOT_INCLUDE	0
 #define	MODE_TO_INCLUDE		1
@@ -241,8 +267,8 @@ char **gNonOptTargets  = NULL;		/* list of all directories to search */
 static void	show_Settings(int optptr, int argc, char **argv);
 static void check_Settings(void);
 static void traverse_DirTree(char *dirpath);
-static int matchNameString(const char *filename, const char *fullpath);
-static int matchTimeStamp(const char *filename, const char *fullpath, struct stat *statp);
+static int matchNameString(const char *filename, int flen, const char *fullpath, int plen);
+static int matchTimeStamp(const char *filename, const char *fullpath, dirEntry_t *entp);
 static int matchFileSize(const char *filename, const char *fullpath, struct stat *statp);
 static int matchPermission(const char *filename, const char *fullpath, struct stat *statp);
 static int parseSizeExactSetting(char *str, int *toskip);
@@ -263,8 +289,14 @@ static char *keepShorterEndString(char *str, char **array, int count);
 static void lowerStrings(char **array, int count);
 static void dumpStrings(char *msg, char **array, int count);
 static int matchStrings(char *str, char **array, int count);
+static int excludedDirName(const char *filename);
+static int excludedDirPath(const char *fullpath);
+static int containsLower(const char *str, const char *lower);
 static void cancelConflicts(char **containsStr, uint containsCnt, char **excludesStr, unsigned int excludesCnt);
 static char *numericToString(size_t size, char *buffer, uint bufsize);
+static int timeInSeconds(char *str);
+static int positiveNumber(const char *str);
+static void cancelHandler(int sig);
 
 /* program options
  */
@@ -301,6 +333,7 @@ static void usage(char *progname, int detail)
 	fprintf(stdout, "  -z<pattern>      name not ends  with <pattern>\n");
 	fprintf(stdout, "  -X<pattern>      path without <pattern>\n");
 	fprintf(stdout, "     -x, -X are matched exclusively (ANY match excludes the entry)\n");
+	fprintf(stdout, "  -N<name>         do not descend into directories named <name>\n");
 	fprintf(stdout, "  -m<regexp>       name matchs <regexp>\n");
 	fprintf(stdout, "  -M<regexp>       path matchs <regexp>\n");
 	fprintf(stdout, "  -n<path>         newer than path\n");
@@ -312,6 +345,14 @@ static void usage(char *progname, int detail)
 	fprintf(stdout, "     -             within <time>\n");
 	fprintf(stdout, "     <time>        in <NNN>(s|m|h|d|w) format\n");
 	}
+	fprintf(stdout, "  -T(m|a|c|b)      time stamp for -n, -o, -t (default m)\n");
+	if (detail)
+	{
+	fprintf(stdout, "     m             last modification\n");
+	fprintf(stdout, "     a             last access\n");
+	fprintf(stdout, "     c             last status change\n");
+	fprintf(stdout, "     b             creation (birth), if kept by the file system\n");
+	}
 	fprintf(stdout, "  -s(+|-|=)<size>  file size constraint (b|k|m|g)\n");
 	if (detail)
 	{
@@ -342,6 +383,22 @@ static void usage(char *progname, int detail)
 	fprintf(stdout, "  -j               junk paths (do not show directory)\n");
 	fprintf(stdout, "  -l#              limit # of found entires\n");
 	fprintf(stdout, "  -L#              limit directory depth/level\n");
+	fprintf(stdout, "  -P#              traverse directories with # threads, big ones by all of them\n");
+	fprintf(stdout, "  --ordered        with -P, output in the same order as a single thread\n");
+	fprintf(stdout, "  --device-threads=#  with -P, at most # threads on one device (slow mounts)\n");
+	fprintf(stdout, "  --adaptive       with -P, up to # threads, as many at work as go fastest\n");
+	fprintf(stdout, "  --prefetch=#     read # directories ahead on helper threads (1, or those of -P),\n");
+	fprintf(stdout, "                   output in the same order as a single thread\n");
+	fprintf(stdout, "  --as-found       with -P, output as entries are found (default, fastest)\n");
+	fprintf(stdout, "  -B               breadth-first search (shallow entries first, not with -P)\n");
+	fprintf(stdout, "  -F               follow symbolic links (every directory is visited once)\n");
+	fprintf(stdout, "  --xdev           stay on the file system of each target directory\n");
+	fprintf(stdout, "  --timeout=<time> wind down after <time>, (s|m|h|d|w) as -t (exit status %d)\n", CLSEEK_EXIT_TIMED_OUT);
+#ifdef	__linux__
+	fprintf(stdout, "  --uring          stat & open entries in batches through io_uring\n");
+	fprintf(stdout, "  --inode-order    stat entries in inode order (rotating disks, cold cache)\n");
+	fprintf(stdout, "  --fs-policy      tune to each file system type, skip /proc, /sys, ... below targets\n");
+#endif	/* __linux__ */
 	fprintf(stdout, "  -i               ignore case distinctions\n");
 	fprintf(stdout, "  -I               enable case distinctions\n");
 	fprintf(stdout, "  -E<program>      execute program or command\n");
@@ -354,6 +411,9 @@ static void usage(char *progname, int detail)
 	if (detail)
 	{
 	fprintf(stdout, "  -S               show settings (all options) and exit\n");
+	fprintf(stdout, "\n");
+	fprintf(stdout, "  Exit status is the # of entries found (%d at most), %d if timed out, %d if interrupted\n",
+		CLSEEK_EXIT_FOUND_MAX, CLSEEK_EXIT_TIMED_OUT, CLSEEK_EXIT_CANCELLED);
 	}
 	fprintf(stdout, "\n");
 	fprintf(stdout, "  Option set in environment variable \"%s\" will be parsed first\n", _ENVVARNAME_);
@@ -494,6 +554,13 @@ main(int argc, char **argv)
 	/*
 	 *** */
 
+	/* wind down cleanly on a deadline or when interrupted, partial results are reported */
+	if (gTimeout) gDeadline = time(NULL) + gTimeout;
+#ifdef	SIGTERM
+	signal(SIGTERM, cancelHandler);
+#endif	/* SIGTERM */
+	signal(SIGINT, cancelHandler);
+
 	/* ***
 	 * DO THE JOB
 	 */
@@ -597,20 +664,30 @@ main(int argc, char **argv)
 	if (gNameExcludesStr) free(gNameExcludesStr);
 	if (gPathContainsStr) free(gPathContainsStr);
 	if (gPathExcludesStr) free(gPathExcludesStr);
+	if (gDirExcludesStr)  free(gDirExcludesStr);
 	if (gNonOptTargets)   free(gNonOptTargets);
 
-	return gTotalMatches;
+	if (gInterrupted) {
+		return (gInterrupted == DIRINFO_TIMED_OUT) ? CLSEEK_EXIT_TIMED_OUT : CLSEEK_EXIT_CANCELLED;
+	}
+	return (gTotalMatches > CLSEEK_EXIT_FOUND_MAX) ? CLSEEK_EXIT_FOUND_MAX : (int) gTotalMatches;
+}
+
+/* SIGINT/SIGTERM: let the traversal wind down, a second signal terminates */
+static void cancelHandler(int sig)
+{
+	gCancelled = 1;
+	signal(sig, SIG_DFL);
 }
 
 
 /* ***********************************
  * support functions
  */
-static int matchNameString(const char *filename, const char *fullpath)
+static int matchNameString(const char *filename, int flen, const char *fullpath, int plen)
 {
 	uint match = 0;
 	uint exclude = 0;
-	int flen = strlen(filename);
 	int (*cmpfunc)(const char *s1, const char *s2, size_t n);
 
 	/* select appropriate compare function */
@@ -748,14 +825,14 @@ static int matchNameString(const char *filename, const char *fullpath)
 
 	/* regular expression matching */
 	if (gFileRegExp) {
-		if (re_search(&gFilePatternBuffer, filename, strlen(filename), 0, strlen(filename), NULL) >= 0) {
+		if (re_search(&gFilePatternBuffer, filename, flen, 0, flen, NULL) >= 0) {
 			if (gDebug > 2) fprintf(stderr, "*** %s matches File regex [%s]\n", fullpath, gFileRegExp);
 			match++;
 		}
 	}
 
 	if (gPathRegExp) {
-		if (re_search(&gPathPatternBuffer, fullpath, strlen(fullpath), 0, strlen(fullpath), NULL) >= 0) {
+		if (re_search(&gPathPatternBuffer, fullpath, plen, 0, plen, NULL) >= 0) {
 			if (gDebug > 2) fprintf(stderr, "*** %s matches Path regex [%s]\n", fullpath, gPathRegExp);
 			match++;
 		}
@@ -766,40 +843,56 @@ static int matchNameString(const char *filename, const char *fullpath)
 	return (match == gPathNameCriteria);
 }
 
+/*
+ * laterThan - compare two time stamps to the nanosecond
+ */
+static int laterThan(const struct timespec *tsp, const struct timespec *refp)
+{
+	return ((tsp->tv_sec > refp->tv_sec) ||
+			((tsp->tv_sec == refp->tv_sec) && (tsp->tv_nsec > refp->tv_nsec)));
+}
+
 /*
  * matchTimeStamp - check if provided entry matches set time criteria
+ *
+ *	gTimeField selects the time stamp (modification, access, change, birth)
  */
-static int matchTimeStamp(const char *filename, const char *fullpath, struct stat *statp)
+static int matchTimeStamp(const char *filename, const char *fullpath, dirEntry_t *entp)
 {
 	uint match = 0;
+	struct timespec ts;
+
+	/* e.g. no birth time on this file system */
+	if (dirinfo_EntryTime(entp, gTimeField, &ts) != 0)
+		return 0;
 
 	if (gPathNewer) {
-		if (statp->st_mtime > gPathNewerStat.st_mtime) {
+		if (laterThan(&ts, &gPathNewerTime)) {
 			if (gDebug > 2) fprintf(stderr, "*** %s (%#x) later than [%s] (%#x)\n",
-				fullpath, (uint)statp->st_mtime, gPathNewer, (unsigned int)gPathNewerStat.st_mtime);
+				fullpath, (uint)ts.tv_sec, gPathNewer, (unsigned int)gPathNewerTime.tv_sec);
 			match++;
 		}
 	}
 
 	if (gPathOlder) {
-		if (statp->st_mtime > gPathOlderStat.st_mtime) {
+		if (laterThan(&ts, &gPathOlderTime)) {
 			if (gDebug > 2) fprintf(stderr, "*** %s (%#x) later than [%s] (%#x)\n",
-				fullpath, (uint)statp->st_mtime, gPathOlder, (unsigned int)gPathOlderStat.st_mtime);
+				fullpath, (uint)ts.tv_sec, gPathOlder, (unsigned int)gPathOlderTime.tv_sec);
 			match++;
 		}
 	}
 
 	if (gTimeDirection && gTimeRange) {
 		if (gDebug > 4) fprintf(stderr, "*** gCurrentTime= %d, gTimeRange= %d\n", (int)gCurrentTime, (int)gTimeRange);
-		if (gDebug > 4) fprintf(stderr, "*** mtime (%s)= %d\n", filename, (int)statp->st_mtime);
+		if (gDebug > 4) fprintf(stderr, "*** time (%s)= %d\n", filename, (int)ts.tv_sec);
 		if ((gTimeDirection == TIME_WITHIN) &&
-			((gCurrentTime - statp->st_mtime) <= (time_t)gTimeRange))
+			((gCurrentTime - ts.tv_sec) <= (time_t)gTimeRange))
 		{
 			if (gDebug > 2) fprintf(stderr, "*** %s matched time_within\n", filename);
 			match++;
 		}
 		else if ((gTimeDirection == TIME_OVER) &&
-			((gCurrentTime - statp->st_mtime) >= (time_t)gTimeRange))
+			((gCurrentTime - ts.tv_sec) >= (time_t)gTimeRange))
 		{
 			if (gDebug > 2) fprintf(stderr, "*** %s matched time_over\n", filename);
 			match++;
@@ -810,6 +903,23 @@ static int matchTimeStamp(const char *filename, const char *fullpath, struct sta
 	return match;
 }
 
+/*
+ * referenceTime - time stamp (gTimeField) of the path given to -n or -o,
+ * the one of the target if it is a symbolic link (as stat() does)
+ */
+static int referenceTime(const char *path, struct timespec *tsp)
+{
+	dirEntry_t entry;
+
+	memset(&entry, 0, sizeof(entry));
+	entry.name     = path;
+	entry.fullpath = path;
+	entry.dirfd    = -1;
+	entry.follow   = 1;
+	entry.needs    = DIRINFO_NEED_TYPE | DIRINFO_NEED_TIME | DIRINFO_NEED_BTIME;
+	return dirinfo_EntryTime(&entry, gTimeField, tsp);
+}
+
 /*
  * matchFileSize - check if provided entry matches set size criteria
  *
@@ -928,9 +1038,15 @@ static int parseSizeExactSetting(char *str, int *toskip)
 }
 
 dirInfo_t gMatchedBuffer = { 0 };	/* match information */
-int seekCallback(const char *filename, const char *fullpath, struct stat *statp, void *opaquep)
+int seekCallback(dirEntry_t *entp, void *opaquep)
 {
+	const char *filename = entp->name;
+	const char *fullpath = entp->fullpath;
+	int  plen = entp->pathLen;		/* strlen(fullpath) */
+	struct stat *statp = NULL;		/* acquired only when needed */
+	int  etype;
 	uint attr = ENTITY_OTHER;
+	int  action = DIRINFO_CONTINUE;	/* DIRINFO_SKIP_SUBTREE when pruned */
 	static uint realMatchedCount = 0;
 
 	/* strip "./" or ".\\" prefix in fullpath */
@@ -939,14 +1055,29 @@ int seekCallback(const char *filename, const char *fullpath, struct stat *statp,
 	{
 		/* skip leading "./" */
 		fullpath += 2;
+		plen -= 2;
 	}
 	if (gDebug > 3) fprintf(stderr, "seekCallback: %s\n", fullpath);
 
 	/* identify entity type */
-	if (S_ISDIR(statp->st_mode))      { attr = ENTITY_DIRECTORY; }
-	else if (S_ISREG(statp->st_mode)) { attr = ENTITY_FILE; }
+	etype = dirinfo_EntryType(entp);
+
+	/* don't descend into directories no entry beneath could match */
+	if (S_ISDIR(etype)) {
+		if (gDirExcludesCnt && excludedDirName(filename)) {
+			/* still matched itself, only the entries beneath are skipped */
+			if (gDebug > 3) fprintf(stderr, "seekCallback: excluded directory %s\n", fullpath);
+			action = DIRINFO_SKIP_SUBTREE;
+		}
+		else if (gPathExcludesCnt && excludedDirPath(fullpath)) {
+			action = DIRINFO_SKIP_SUBTREE;
+		}
+	}
+
+	if (S_ISDIR(etype))      { attr = ENTITY_DIRECTORY; }
+	else if (S_ISREG(etype)) { attr = ENTITY_FILE; }
 #if	!defined(_WIN32) && !defined(__CYGWIN32__)
-	else if (S_ISLNK(statp->st_mode)) { attr = ENTITY_SYMLINK; }
+	else if (S_ISLNK(etype)) { attr = ENTITY_SYMLINK; }
 #endif	/* !_WIN32 && !__CYGWIN32__ */
 
 	/* match entity attribute */
@@ -957,7 +1088,7 @@ int seekCallback(const char *filename, const char *fullpath, struct stat *statp,
 			(attr==ENTITY_SYMLINK)?"SYMLINK":
 #endif	/* !_WIN32 && !__CYGWIN32__ */
 			(attr==ENTITY_FILE)?"FILE":"other");
-		return 0;
+		return action;
 	}
 
 	/* real match... */
@@ -984,7 +1115,7 @@ int seekCallback(const char *filename, const char *fullpath, struct stat *statp,
 		printf("%s\r%s\r", CLEAR_LINE, fullpath);
 //		printf("%s\r[%d:%d]-%s", CLEAR_LINE, gTerminalSize.ws_col, lastLineLen, fullpath);
 		fflush(stdout);
-        lastLineLen = (int)strlen(fullpath);
+        lastLineLen = plen;
 	}
   #endif
 #endif
@@ -993,10 +1124,13 @@ int seekCallback(const char *filename, const char *fullpath, struct stat *statp,
 	if (
 		/* matching [path]name with patterns */
 		((gPathNameCriteria == 0) ||
-		(gPathNameCriteria && matchNameString(filename, fullpath))) &&
+		(gPathNameCriteria && matchNameString(filename, entp->nameLen, fullpath, plen))) &&
+		/* stat the entry only if it is to be looked into */
+		((gStatCriteria == 0) ||
+		((statp = dirinfo_EntryStat(entp)) != NULL)) &&
 		/* matching timestamp constraints */
 		((gTimeStampCriteria == 0) ||
-		(gTimeStampCriteria && matchTimeStamp(filename, fullpath, statp))) &&
+		(gTimeStampCriteria && matchTimeStamp(filename, fullpath, entp))) &&
 		/* matching size constraints */
 		((gFileSizeCriteria == 0) ||
 		(gFileSizeCriteria && matchFileSize(filename, fullpath, statp))) &&
@@ -1112,9 +1246,9 @@ int seekCallback(const char *filename, const char *fullpath, struct stat *statp,
 		else if (attr == ENTITY_FILE) { gMatchedBuffer.num_of_files++; }
 		else                          { gMatchedBuffer.num_of_others++; }
 
-		/* EXIT the program if have we found enough entries? */
+		/* have we found enough entries? end the traversal */
 		if (gLimitEntry == realMatchedCount)
-			exit (gLimitEntry);
+			return DIRINFO_STOP;
 	}
 
 #ifdef  __1_71g__
@@ -1123,12 +1257,12 @@ int seekCallback(const char *filename, const char *fullpath, struct stat *statp,
 		// print verbose line
 		printf("%s\r%s", CLEAR_LINE, fullpath);
 		fflush(stdout);
-		gLastVerboseLen = (uint32_t)strlen(fullpath);
+		gLastVerboseLen = (uint32_t)plen;
 	}
 #endif
 #endif  // __1_71g__
 
-	return 0;
+	return action;
 }
 
 static void dumpStrings(char *msg, char **array, int count)
@@ -1160,6 +1294,18 @@ static void	show_Settings(int optptr, int argc, char **argv)
 	fprintf(stderr, "junk output path:     %s\n", gJunkPaths ? "TRUE" : "FALSE");
 	fprintf(stderr, "recursive mode:       %s\n", gRecursive ? "TRUE" : "FALSE");
 	fprintf(stderr, "directory level:      %d (0 = unlimited)\n", gLimitDirLevel);
+	fprintf(stderr, "threads:              %u\n", gThreads);
+	fprintf(stderr, "ordered output:       %s\n", gOrdered ? "TRUE" : "FALSE");
+	fprintf(stderr, "threads per device:   %d (0 = all)\n", gDeviceThreads);
+	fprintf(stderr, "adaptive threads:     %s\n", gAdaptive ? "TRUE" : "FALSE");
+	fprintf(stderr, "prefetch directories: %d (0 = none)\n", gPrefetch);
+	fprintf(stderr, "breadth first:        %s\n", gBreadthFirst ? "TRUE" : "FALSE");
+	fprintf(stderr, "io_uring:             %s\n", gUring ? "TRUE" : "FALSE");
+	fprintf(stderr, "inode order:          %s\n", gInodeOrder ? "TRUE" : "FALSE");
+	fprintf(stderr, "file system policy:   %s\n", gFsPolicy ? "TRUE" : "FALSE");
+	fprintf(stderr, "follow links:         %s\n", gFollowLinks ? "TRUE" : "FALSE");
+	fprintf(stderr, "one file system:      %s\n", gOneFileSystem ? "TRUE" : "FALSE");
+	fprintf(stderr, "timeout:              %u seconds (0 = unlimited)\n", gTimeout);
 	fprintf(stderr, "quiet mode:           %s\n", gQuietMode ? "TRUE" : "FALSE");
 	fprintf(stderr, "verbose mode:         %s\n", gVerboseMode ? "TRUE" : "FALSE");
 	fprintf(stderr, "nul terminator:       %s\n", gNulTerminator ? "TRUE" : "FALSE");
@@ -1171,10 +1317,15 @@ static void	show_Settings(int optptr, int argc, char **argv)
 	fprintf(stderr, "file regexp is:       %s\n", gFileRegExp ? gFileRegExp : "");
 	      dumpStrings("path contains", gPathContainsStr, gPathContainsCnt);
 	      dumpStrings("path excludes", gPathExcludesStr, gPathExcludesCnt);
+	      dumpStrings("dir excludes", gDirExcludesStr, gDirExcludesCnt);
 	fprintf(stderr, "path regexp is:       %s\n", gPathRegExp ? gPathRegExp : "");
 	fprintf(stderr, "# of name string criteria=%d\n", gPathNameCriteria);
 	fprintf(stderr, "path must newer than: %s\n", gPathNewer ? gPathNewer : "");
 	fprintf(stderr, "path must older than: %s\n", gPathOlder ? gPathOlder : "");
+	fprintf(stderr, "time stamp compared:  %s\n",
+					gTimeField==DIRINFO_ATIME ? "ACCESS" :
+					gTimeField==DIRINFO_CTIME ? "CHANGE" :
+					gTimeField==DIRINFO_BTIME ? "BIRTH" : "MODIFICATION");
 	if (gTimeStampCriteria) {
 	fprintf(stderr, "path must be modified %s%d seconds%s\n",
 					gTimeDirection==TIME_WITHIN ? "WITHIN " : "",
@@ -1236,6 +1387,28 @@ static void check_Settings()
 		gEntityAttribute = (ENTITY_FILE | ENTITY_DIRECTORY | ENTITY_SYMLINK);
 	}
 
+	/* time stamps of -n, -o reference paths, once the time field is known */
+	if (gPathNewer && (referenceTime(gPathNewer, &gPathNewerTime) != 0)) {
+		fprintf(stderr, "-n%s: time stamp not available, ignored\n", gPathNewer);
+		gPathNewer = NULL;
+		gTimeStampCriteria--;
+	}
+	if (gPathOlder && (referenceTime(gPathOlder, &gPathOlderTime) != 0)) {
+		fprintf(stderr, "-o%s: time stamp not available, ignored\n", gPathOlder);
+		gPathOlder = NULL;
+		gTimeStampCriteria--;
+	}
+
+	/* the threads go their own way, breadth first is up to a single one */
+	if (gBreadthFirst && ((gThreads > 1) || gPrefetch)) {
+		fprintf(stderr, "-B: not with -P or --prefetch, ignored\n");
+		gBreadthFirst = 0;
+	}
+
+	/* does seekCallback need the file status (beyond the entry type)? */
+	gStatCriteria = gTimeStampCriteria + gFileSizeCriteria + gPermissionCriteria +
+					((gEntityAttribute & ENTITY_DETAILS) ? 1 : 0);
+
 	/* cancel out gNameContains and gNameExcludes if they conflict to each other */
 //	if (nclen && nelen && (nclen >= nelen)) {
 //		if (strcmp(gNameContains, gNameExcludes) == 0) {
@@ -1258,6 +1431,7 @@ static void check_Settings()
 		if (gNameExcludesEndCnt)   lowerStrings(gNameExcludesEndStr,   gNameExcludesEndCnt);
 		if (gPathContainsCnt) lowerStrings(gPathContainsStr, gPathContainsCnt);
 		if (gPathExcludesCnt) lowerStrings(gPathExcludesStr, gPathExcludesCnt);
+		if (gDirExcludesCnt)  lowerStrings(gDirExcludesStr,  gDirExcludesCnt);
 	}
 
 	return;
@@ -1278,21 +1452,78 @@ static void traverse_DirTree(char *dirpath)
 		pathp = dirpath;
 	}
 
+	/* enough entries found under the directories visited before */
+	if (gLimitEntry && (gTotalMatches >= gLimitEntry)) {
+		return;
+	}
+	/* no time left for the targets after */
+	if (gInterrupted) {
+		return;
+	}
+
 	if (gDebug) {
 		/* enable debug output */
 		mcbuf.printf=(OutputFunc)XOutput;
 	}
 
-	mcbuf.proc = seekCallback;	/* callback routine */
+	mcbuf.entryProc = seekCallback;	/* callback routine (stat on demand) */
 	// mcbuf.printf = fdsout;			/* output routine */
+#ifndef	_MSC_VER
+	mcbuf.flags |= DIRINFO_FDRELATIVE;	/* openat()/fstatat() instead of lstat() on full path */
+#ifdef	__linux__
+	mcbuf.flags |= DIRINFO_GETDENTS;	/* bulk directory reads */
+#endif	/* __linux__ */
+	if (gBreadthFirst) mcbuf.flags |= DIRINFO_BFS;
+	if (gUring) mcbuf.flags |= DIRINFO_URING;	/* falls back to synchronous calls */
+	if (gInodeOrder && gStatCriteria) mcbuf.flags |= DIRINFO_INODE_ORDER;	/* output still in directory order */
+	if (gFollowLinks) mcbuf.flags |= DIRINFO_FOLLOW;
+	if (gFsPolicy) mcbuf.flags |= DIRINFO_FS_POLICY;	/* per mount, looked up at mount points */
+#endif	/* !_MSC_VER */
+	if (gOneFileSystem) mcbuf.flags |= DIRINFO_ONE_FS;
+	mcbuf.cancel   = &gCancelled;
+	mcbuf.deadline = gDeadline;
+
+	/* stat fields seekCallback looks into (statx mask) */
+	mcbuf.needs = DIRINFO_NEED_TYPE;
+	if (gTimeStampCriteria) mcbuf.needs |= (gTimeField == DIRINFO_BTIME) ? DIRINFO_NEED_BTIME : DIRINFO_NEED_TIME;
+	if (gFileSizeCriteria) mcbuf.needs |= DIRINFO_NEED_SIZE;
+	if (gPermissionCriteria) mcbuf.needs |= DIRINFO_NEED_MODE;
+	if (gEntityAttribute & ENTITY_DETAILS) mcbuf.needs |= DIRINFO_NEED_TIME | DIRINFO_NEED_SIZE;
 
 	/* search directory info */
-	dirinfo_Find(pathp, &dibuf, &mcbuf, (int) gRecursive, (int) gLimitDirLevel, 1 /*current dir level*/);
+	if ((gThreads > 1) || gPrefetch) {
+		/* seekCallback is not thread-safe, but stat the entries in parallel */
+		mcbuf.flags |= DIRINFO_SERIALIZE;
+		if (gStatCriteria) mcbuf.flags |= DIRINFO_PRESTAT | DIRINFO_CHUNKS;	/* big directories by all threads */
+		if (gOrdered || gPrefetch) mcbuf.flags |= DIRINFO_ORDERED;	/* workers read ahead, matches in sequential order */
+		mcbuf.prefetchMax = (int) gPrefetch;	/* the next directories are read while matching */
+		mcbuf.deviceMax = (int) gDeviceThreads;	/* a slow mount does not hold up the others */
+		if (gAdaptive) mcbuf.flags |= DIRINFO_ADAPTIVE;	/* fewer threads if more do not help */
+		dirinfo_FindParallel(pathp, &dibuf, &mcbuf, (int) gRecursive, (int) gLimitDirLevel, 1 /*current dir level*/,
+			(gThreads > 1) ? (int) gThreads : 2 /*one helper*/);
+	}
+	else {
+		dirinfo_Find(pathp, &dibuf, &mcbuf, (int) gRecursive, (int) gLimitDirLevel, 1 /*current dir level*/);
+	}
+
+	/* how far it got */
+	if (dibuf.interrupted) {
+		gInterrupted = dibuf.interrupted;
+		fprintf(stderr, "%s: %s after %lld entries, %u found\n", pathp,
+			(gInterrupted == DIRINFO_TIMED_OUT) ? "timed out" : "interrupted",
+			dibuf.num_of_directories + dibuf.num_of_files + dibuf.num_of_others, gTotalMatches);
+	}
+
+	/* directories left out, the matches are not complete */
+	if (dibuf.errors) {
+		fprintf(stderr, "%s: %d directories could not be read in full (-d3 for details)\n", pathp, dibuf.errors);
+	}
 
 	/* closing report */
 	if (gDebug > 4) {
 		dirinfo_Report(&dibuf, "total");
 		dirinfo_Report(&gMatchedBuffer, "matched");
+		if (dibuf.threads) fprintf(stdout, "# of total threads     %d\n", dibuf.threads);
 	}
 }
 
@@ -1336,6 +1567,7 @@ static int32_t parse_Parameters(char *progname, int argc, char **argv)
 //	extern char *optarg;
 //	extern int optind;
 	int errflags = 0;
+	int threads;			/* -P */
 
 //https://stackoverflow.com/a/15305354/663485
 #if	defined(_WIN32)
@@ -1358,7 +1590,7 @@ static int32_t parse_Parameters(char *progname, int argc, char **argv)
 	 */
 	optptr = NULL;
 	// while ((c = getopt(argc, argv, "abo:")) != EOF)
-	while ((optcode = fds_getopt(&optptr, "?hva:=:b:c:e:x:y:z:m:n:o:C:X:M:t:s:w:p:D:jl:L:rRiIE:qV0d:", argc, argv)) != EOF)
+	while ((optcode = fds_getopt(&optptr, "?hva:=:b:c:e:x:y:z:m:n:o:C:X:N:M:t:T:s:w:p:D:jl:L:P:BFrRiIE:qV0d:", argc, argv)) != EOF)
 	{
 		//-dbg- printf("optcode=%c *optptr=%c\n", optcode, *optptr);
 		switch (optcode) {
@@ -1552,6 +1784,14 @@ static int32_t parse_Parameters(char *progname, int argc, char **argv)
 						break;
 					}
 
+			case 'N':
+					{
+						/* directories not to descend into, e.g. -N.git -Nnode_modules */
+						gDirExcludesStr = (char **) realloc(gDirExcludesStr, (++gDirExcludesCnt)*sizeof(char*));
+						gDirExcludesStr[(gDirExcludesCnt-1)] = optptr;
+						break;
+					}
+
 			/* time matching criteria */
 			case 'n':
 					{	/* check if specified path exists */
@@ -1600,6 +1840,20 @@ static int32_t parse_Parameters(char *progname, int argc, char **argv)
 						break;
 					}
 
+			case 'T':
+					/* --- time stamp compared by -n, -o, -t --- */
+					switch (*optptr) {
+					case 'm':  gTimeField = DIRINFO_MTIME;	break;
+					case 'a':  gTimeField = DIRINFO_ATIME;	break;
+					case 'c':  gTimeField = DIRINFO_CTIME;	break;
+					case 'b':  gTimeField = DIRINFO_BTIME;	break;
+					default:
+						fprintf(stderr, "-%c%s: unknown time stamp\n", optcode, optptr);
+						errflags++;
+						break;
+					}
+					break;
+
 			case 's':
 					/* --- file size constraint --- */
 					{
@@ -1697,6 +1951,21 @@ static int32_t parse_Parameters(char *progname, int argc, char **argv)
 					}
 					break;
 
+			/* # of threads traversing directories */
+			case 'P':
+					if ((threads = positiveNumber((char *) optptr)) <= 0) {
+						fprintf(stderr, "(-P) invalid number of threads: %s\n", (char *) optptr);
+						errflags++;
+					}
+					else gThreads = (uint) threads;
+					break;
+
+			/* breadth-first search */
+			case 'B':  gBreadthFirst++;	break;
+
+			/* follow symbolic links */
+			case 'F':  gFollowLinks++;	break;
+
 			/* recursive mode */
 			case 'R':
 			case 'r':  gRecursive++;	break;
@@ -1776,6 +2045,62 @@ static int32_t parse_Parameters(char *progname, int argc, char **argv)
 
 			/* special option - option starts with "--" */
 			case OPT_SPECIAL:
+					/* traversal engine settings */
+					if (strcmp(optptr, "uring") == 0) {
+						gUring++;
+						break;
+					}
+					if (strcmp(optptr, "inode-order") == 0) {
+						gInodeOrder++;
+						break;
+					}
+					if (strcmp(optptr, "fs-policy") == 0) {
+						gFsPolicy++;
+						break;
+					}
+					if ((strcmp(optptr, "xdev") == 0) || (strcmp(optptr, "one-file-system") == 0)) {
+						gOneFileSystem++;
+						break;
+					}
+					if (strcmp(optptr, "ordered") == 0) {
+						gOrdered = 1;
+						break;
+					}
+					if (strcmp(optptr, "as-found") == 0) {
+						gOrdered = 0;
+						break;
+					}
+					if (strncmp(optptr, "prefetch=", 9) == 0) {
+						int count = positiveNumber(&optptr[9]);
+						if (count <= 0) {
+							fprintf(stderr, "--prefetch: %s: invalid number of directories\n", &optptr[9]);
+							errflags++;
+						}
+						else gPrefetch = (uint) count;
+						break;
+					}
+					if (strcmp(optptr, "adaptive") == 0) {
+						gAdaptive++;
+						break;
+					}
+					if (strncmp(optptr, "device-threads=", 15) == 0) {
+						int count = positiveNumber(&optptr[15]);
+						if (count <= 0) {
+							fprintf(stderr, "--device-threads: %s: invalid number of threads\n", &optptr[15]);
+							errflags++;
+						}
+						else gDeviceThreads = (uint) count;
+						break;
+					}
+					if (strncmp(optptr, "timeout=", 8) == 0) {
+						int seconds = timeInSeconds((char *) &optptr[8]);
+						if (seconds <= 0) {
+							fprintf(stderr, "--timeout: %s: invalid time (e.g. 30s, 10m, 2h)\n", &optptr[8]);
+							errflags++;
+						}
+						else gTimeout = (uint) seconds;
+						break;
+					}
 					if (strcmp(optptr, "help") == 0) {
 						version(progname);	usage(progname, 1);
 					}
@@ -1870,6 +2195,20 @@ static int timeInSeconds(char *str)
 	return (int) trange;
 }
 
+/* a decimal count > 0 and nothing after it (-1 = invalid) */
+static int positiveNumber(const char *str)
+{
+	char *endp;
+	long  count;
+
+	errno = 0;
+	count = strtol(str, &endp, 10);
+	if ((endp == str) || (*endp != '\0') || (errno != 0) || (count <= 0) || (count > INT_MAX)) {
+		return -1;
+	}
+	return (int) count;
+}
+
 /* parse time constraint parameter
  *
  *	Global variables will be updated:	gTimeDirection & gTimeRange
@@ -2410,6 +2749,53 @@ static int matchStrings(char *str, char **array, int count)
 	return match;
 }
 
+/*
+ * excludedDirName - is the directory to be skipped by name (-N)
+ */
+static int excludedDirName(const char *filename)
+{
+	uint ix;
+	for (ix = 0; ix < gDirExcludesCnt; ix++) {
+		if ((gIgnoreCase ? stricmp(filename, gDirExcludesStr[ix]) : strcmp(filename, gDirExcludesStr[ix])) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * excludedDirPath - does the directory path contain a -X pattern
+ *
+ *	-X is matched against the path of the entry without the filename, which
+ *	for every entry beneath this directory begins with fullpath.  So if
+ *	fullpath contains a pattern, none of them can match.
+ *	The patterns are in lower case already with -i (check_Settings).
+ */
+static int excludedDirPath(const char *fullpath)
+{
+	uint ix;
+	for (ix = 0; ix < gPathExcludesCnt; ix++) {
+		if (gPathExcludesStr[ix] == NULL) continue;
+		if (gIgnoreCase ? containsLower(fullpath, gPathExcludesStr[ix]) : (strstr(fullpath, gPathExcludesStr[ix]) != NULL))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * containsLower - does str contain lower, case ignored (lower is in lower case)
+ */
+static int containsLower(const char *str, const char *lower)
+{
+	size_t ix;
+
+	do {
+		for (ix = 0; lower[ix] && (tolower((unsigned char) str[ix]) == lower[ix]); ix++)
+			;
+		if (lower[ix] == 0) return 1;
+	} while (*str++);
+	return 0;
+}
+
 /* Cancel conflict matching pattern in "containsStr" and "excludesStr" arrays
  */
 static void cancelConflicts(char **containsStr, uint containsCnt, char **excludesStr, unsigned int excludesCnt)
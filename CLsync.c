@@ -156,9 +156,9 @@ static void reverse_check_tree(char *srcdir, char *dstdir);
 static boolean isEmptyDirectory(const char *dirpath);
 /* callback functions
  */
-static void syncCallback(const char *name, const char *path, struct stat *statp, void *opaquep);
-static void reverseCallback(const char *name, const char *path, struct stat *statp, void *opaquep);
-static void rmdirCallback(const char *name, const char *path, struct stat *statp, void *opaquep);
+static int syncCallback(const char *name, const char *path, struct stat *statp, void *opaquep);
+static int reverseCallback(const char *name, const char *path, struct stat *statp, void *opaquep);
+static int rmdirCallback(const char *name, const char *path, struct stat *statp, void *opaquep);
 /* sync. support functions
  */
 static boolean confirmDeletion(char *src, int overwrite);
@@ -339,7 +339,7 @@ main(int argc, char **argv)
  * ----------------------
  */
 //
-static void syncCallback(const char *filename, const char *fullpath, struct stat *statp, void *opaquep)
+static int syncCallback(const char *filename, const char *fullpath, struct stat *statp, void *opaquep)
 {
 	char dstPath[PATH_MAX];
 
@@ -363,7 +363,7 @@ static void syncCallback(const char *filename, const char *fullpath, struct stat
 		/* do nothing if this entry is excluded
 		 */
 		if (gDebug & 0x04) fprintf(stderr, "(syncCB-Excluded) %s [rel:%s]\n", fullpath, &fullpath[gSrcDirLen]);
-		return;
+		return DIRINFO_CONTINUE;
 	}
 	//
 	//	check for inclusive pattern(s)
@@ -374,7 +374,7 @@ static void syncCallback(const char *filename, const char *fullpath, struct stat
 		/* inclusive pattern(s) specified
 		 */
 		if (gDebug & 0x04) fprintf(stderr, "(syncCB-Contained-NO-match) %s [rel:%s]\n", fullpath, &fullpath[gSrcDirLen]);
-		return;
+		return DIRINFO_CONTINUE;
 	}
 
 	/* destination path */
@@ -391,13 +391,13 @@ static void syncCallback(const char *filename, const char *fullpath, struct stat
 
 		if (gSkipEmptySource && isEmptyDirectory(fullpath)) {
 			/* empty source directory will NOT be copied */
-			return;
+			return DIRINFO_CONTINUE;
 		}
 
 		/* srcDIR */
 		if (IsFile(dstPath) && deleteEntry(dstPath, gForceOverwrite) < 0) {
 			// cannot remove existing entry
-			return;
+			return DIRINFO_CONTINUE;
 		}
 		/* check dstDIR */
 		if ((_access(dstPath, 0)) == -1) {
@@ -414,7 +414,7 @@ static void syncCallback(const char *filename, const char *fullpath, struct stat
 		sFileCheckCount++;
 		if (IsDirectory(dstPath) && deleteEntry(dstPath, gForceOverwrite) < 0) {
 			// cannot remove existing entry
-			return;
+			return DIRINFO_CONTINUE;
 		}
 		/* check dstFILE */
 		if ((_access(dstPath, 0)) == -1) {
@@ -438,11 +438,11 @@ static void syncCallback(const char *filename, const char *fullpath, struct stat
 			}
 		}
 	}
-	return;
+	return DIRINFO_CONTINUE;
 }
 
 //
-static void reverseCallback(const char *dstfile, const char *dstpath, struct stat *statp, void *opaquep)
+static int reverseCallback(const char *dstfile, const char *dstpath, struct stat *statp, void *opaquep)
 {
 	int srcdir = (int)((matchCriteria_t*)opaquep)->iblock;
 	char srcPath[256];
@@ -474,7 +474,7 @@ static void reverseCallback(const char *dstfile, const char *dstpath, struct sta
 		/* do nothing if this entry is excluded
 		 */
 		if (gDebug & 0x04) fprintf(stderr, "(reverseCB-Excluded) %s [rel:%s]\n", dstpath, &dstpath[gDstDirLen]);
-		return;
+		return DIRINFO_CONTINUE;
 	}
 	//
 	//	check for inclusive pattern(s)
@@ -485,7 +485,7 @@ static void reverseCallback(const char *dstfile, const char *dstpath, struct sta
 		/* inclusive pattern(s) specified
 		 */
 		if (gDebug & 0x04) fprintf(stderr, "(reverseCB-Contained-NO-match) %s [rel:%s]\n", dstpath, &dstpath[gDstDirLen]);
-		return;
+		return DIRINFO_CONTINUE;
 	}
 
 	/* source path */
@@ -518,7 +518,7 @@ static void reverseCallback(const char *dstfile, const char *dstpath, struct sta
 			if (gKeepTargetEntry == 0) { deleteFile((char*)dstpath); }
 		}
 	}
-	return;
+	return DIRINFO_CONTINUE;
 }
 
 
@@ -800,9 +800,9 @@ static void traverse_sync_trees(char *srcdir, char *dstdir)
 	//
 	// traverse the source directory tree
 	//
-	mcbuf.proc = (FILEPROC) syncCallback;	/* callback routine */
+	mcbuf.proc = syncCallback;	/* callback routine */
 	//
-	dirinfo_Find(srcdir, &dibuf, &mcbuf, (int) gRecursive);
+	dirinfo_Find(srcdir, &dibuf, &mcbuf, (int) gRecursive, 0, 0);
 
 	/* closing report */
 	if (gDebug & 0x40) {
@@ -839,10 +839,10 @@ static void reverse_check_tree(char *srcdir, char *dstdir)
 	//
 	// check the destination directory tree (NO recursive)
 	//
-	mcbuf.proc = (FILEPROC) reverseCallback;	/* callback routine */
+	mcbuf.proc = reverseCallback;	/* callback routine */
 	mcbuf.iblock = (void*)srcdir;	/* opaque information */
 	//
-	dirinfo_Find(dstdir, NULL, &mcbuf, 0 /*non-recursive*/);
+	dirinfo_Find(dstdir, NULL, &mcbuf, 0 /*non-recursive*/, 0, 0);
 	return;
 }
 
@@ -860,7 +860,7 @@ static boolean isEmptyDirectory(const char *dirpath)
 	if (!IsDirectory(dirpath)) { return FALSE; }
 
 	// perform directory find
-	dirinfo_Find(dirpath, &dibuf, NULL, 0 /*non-recursive*/);
+	dirinfo_Find(dirpath, &dibuf, NULL, 0 /*non-recursive*/, 0, 0);
 
 	if (gSkipEmptySource == ONLY_EMPTY_ENTRY)
 		return ((dibuf.num_of_directories + dibuf.num_of_files + dibuf.num_of_others) == 0);
@@ -1231,7 +1231,7 @@ static int deleteFile(char *src)
 
 /* callback used in deleteDir()
  */
-static void rmdirCallback(const char *filename, const char *rdpath, struct stat *statp, void *opaquep)
+static int rmdirCallback(const char *filename, const char *rdpath, struct stat *statp, void *opaquep)
 {
 	int recursive = (int)((matchCriteria_t*)opaquep)->iblock;
 
@@ -1240,6 +1240,7 @@ static void rmdirCallback(const char *filename, const char *rdpath, struct stat
 	{
 		//-debug- fprintf(stderr, "_dir_: %s\n", rdpath);
 		deleteDir((char*)rdpath, recursive);
+		return DIRINFO_SKIP_SUBTREE;	/* already taken care of */
 	}
 	else if (S_ISREG(statp->st_mode))
 	{
@@ -1250,7 +1251,7 @@ static void rmdirCallback(const char *filename, const char *rdpath, struct stat
 		//-debug- fprintf(stderr, "_unknown_: %s\n", rdpath);
 		deleteFile((char*)rdpath);
 	}
-	return;
+	return DIRINFO_CONTINUE;
 }
 /*
  * deleteDir - delete the specified directory (recursively if requested)
@@ -1270,10 +1271,10 @@ static int deleteDir(char *src, int recursive)
 
 	/* prepare to delete the directory [tree] */
 	fprintf(stderr, "[%s-remove] %sdelete %s\n", gDryRun?"would":"sync", recursive?"recursively ":"", src); sDirDeleteCount++;
-	mcbuf.proc = (FILEPROC) rmdirCallback;
+	mcbuf.proc = rmdirCallback;
 	mcbuf.iblock = (void*)recursive;
 	/* search directory info */
-	dirinfo_Find(src, NULL, &mcbuf, (int) recursive);
+	dirinfo_Find(src, NULL, &mcbuf, (int) recursive, 0, 0);
 
 	/* delete myself */
 	if (gDryRun == 0) {
@@ -37,11 +37,494 @@
 
 #if	defined(unix) || defined(__STDC__)
 #include <dirent.h>		/* DIR structure */
+#include <unistd.h>		/* close */
+#endif
+#ifndef	_MSC_VER
+#include <pthread.h>	/* parallel traversal */
+#include <sys/resource.h>	/* RLIMIT_NOFILE */
+#endif	/* !_MSC_VER */
+#if	defined(__linux__)
+#include <stdint.h>
+#include <sys/syscall.h>	/* SYS_getdents64 */
+#include <sys/vfs.h>		/* fstatfs, f_type */
+#if	defined(__has_include)
+#if	__has_include(<linux/stat.h>)
+#include <sys/sysmacros.h>	/* makedev */
+#include <linux/stat.h>		/* struct statx */
+#endif
+#if	__has_include(<linux/io_uring.h>)
+#include <sys/mman.h>		/* io_uring rings */
+#include <linux/io_uring.h>
+#endif
+#endif	/* __has_include */
 #endif
 
 #include "mygetopt.h"
 #include "dirinfo.h"
 
+#ifndef	DTTOIF
+#define	DTTOIF(dirtype)	((dirtype) << 12)
+#endif
+#ifndef	IFTODT
+#define	IFTODT(mode)	(((mode) & 0170000) >> 12)
+#endif
+#ifdef	DT_UNKNOWN
+#define	DIRENT_TYPE(dp)	((dp)->d_type)
+#else
+#define	DIRENT_TYPE(dp)	0
+#endif	/* DT_UNKNOWN */
+/* nanoseconds of a time stamp in struct stat, t = m, a or c */
+#if	defined(_WIN32)
+#define	STAT_NSEC(sbp, t)	0
+#elif	defined(__APPLE__)
+#define	STAT_NSEC(sbp, t)	((sbp)->st_##t##timespec.tv_nsec)
+#else
+#define	STAT_NSEC(sbp, t)	((sbp)->st_##t##tim.tv_nsec)
+#endif	/* _WIN32 */
+
+/* the traversal is stopped (dirFind_t.stopped, dirWalk_t.stopped, dirPool_t.stopped)
+ * by a callback returning DIRINFO_STOP, or cut short (DIRINFO_CANCELLED, DIRINFO_TIMED_OUT)
+ */
+#define	STOP_CALLBACK	(-1)
+#define	DIRINFO_DEADLINE_TICKS	64	/* entries between looks at the clock */
+
+/* state shared by all levels of one dirinfo_Find() call (readdir() walk) */
+typedef struct dirFind {
+	int              baseLevel;		/* level of the top directory */
+	BOOL             bSizes;		/* add up bytes & blocks (DIRINFO_SIZES) */
+	BOOL             bOneFs;		/* do not cross mount points */
+	dev_t            rootDev;		/* device of the top directory */
+	int              stopped;		/* STOP_CALLBACK, DIRINFO_CANCELLED or DIRINFO_TIMED_OUT */
+	unsigned         ticks;			/* entries visited, the deadline is checked every so often */
+	int              delimiter;		/* path delimiter */
+	void            *buffers;		/* kept by the context between traversals (NULL - none) */
+	char            *path;			/* pathname of the entry being visited */
+	size_t           pathSize;
+} dirFind_t;
+
+#ifndef	_MSC_VER
+#if	defined(__linux__) && defined(SYS_getdents64)
+#define	HAVE_GETDENTS64	1
+/* record returned by getdents64() */
+struct linuxDirent64 {
+	uint64_t        d_ino;
+	int64_t         d_off;
+	unsigned short  d_reclen;
+	unsigned char   d_type;
+	char            d_name[];
+};
+#define	DIRENT_DEEP_BUFSIZE	(32*1024)	/* buffers are halved per depth down to this size */
+#endif	/* __linux__ && SYS_getdents64 */
+#if	defined(__linux__) && defined(SYS_statx) && defined(STATX_BASIC_STATS) && defined(STATX_BTIME)
+#define	HAVE_STATX		1
+#endif	/* __linux__ && SYS_statx && STATX_BASIC_STATS && STATX_BTIME */
+#if	defined(IORING_FEAT_SINGLE_MMAP) && defined(SYS_io_uring_setup) && defined(HAVE_STATX)
+#define	HAVE_IO_URING	1
+#define	DIRINFO_URING_ENTRIES	256		/* submission queue size */
+#define	DIRINFO_URING_MAXFDS	64		/* sub-directories opened in advance */
+#endif	/* IORING_FEAT_SINGLE_MMAP && SYS_io_uring_setup && HAVE_STATX */
+
+/* directory stream, either readdir() or getdents64() */
+typedef struct dirReader {
+	DIR     *dirp;			/* readdir() stream (NULL when reading with getdents64) */
+	int      fd;			/* directory descriptor */
+	char    *buf;			/* getdents64() record buffer */
+	size_t   bufsize;
+	long     bpos;			/* offset of next record */
+	long     blen;			/* bytes of records in buffer */
+	BOOL     bNoType;		/* d_type is not to be trusted, reported as unknown */
+	int      error;			/* errno of a failed read, the directory ended there (0 - none) */
+} dirReader_t;
+
+/* traversal policy of a file system type (DIRINFO_FS_POLICY) */
+typedef struct dirFsPolicy {
+	unsigned long    type;			/* statfs f_type */
+	const char      *name;
+	int              flags;			/* DIRFS_xxx */
+	int              chunkSize;		/* DIRINFO_CHUNKS: entries per chunk (0 - as set, -1 - not split) */
+} dirFsPolicy_t;
+
+#define	DIRFS_PSEUDO		0x01	/* kernel pseudo file system, not entered below the top directory */
+#define	DIRFS_NO_DTYPE		0x02	/* d_type is not trusted, the entries are stat'ed for their type */
+#define	DIRFS_INODE_ORDER	0x04	/* stat the entries in inode order (hashed directory order) */
+
+/* entry of a directory read in advance (DIRINFO_URING) */
+typedef struct dirItem {
+	size_t           nameOff;		/* offset of the name in the name buffer */
+	ino_t            ino;
+	int              type;			/* d_type */
+	int              statDone;		/* 0 - not yet, 1 - sb is valid, -1 - failed */
+	int              fd;			/* sub-directory opened in advance (-1 - none) */
+	int              action;		/* set by batchProc (DIRINFO_SKIP_SUBTREE) */
+	int              hasBtime;		/* btime is valid */
+	time_t           btime;
+	long             btimeNsec;
+	struct stat      sb;
+} dirItem_t;
+
+/* inode number of a list item, for sorting */
+typedef struct dirOrder {
+	ino_t            ino;
+	int              ix;			/* item index */
+} dirOrder_t;
+
+#define	DEVINO_HASH(dev, ino)	((size_t) ((((unsigned long long) (ino) * 0x9E3779B97F4A7C15ULL) ^ \
+									((unsigned long long) (dev) * 0xC2B2AE3D27D4EB4FULL)) >> 17))
+
+/* set of directories visited (DIRINFO_FOLLOW), open addressing by (st_dev, st_ino) */
+typedef struct dirDevIno {
+	dev_t            dev;
+	ino_t            ino;			/* 0 - empty slot */
+} dirDevIno_t;
+typedef struct dirVisited {
+	dirDevIno_t     *slots;
+	size_t           size;			/* power of 2 */
+	size_t           count;
+	pthread_mutex_t *lock;			/* shared by workers (NULL - not shared) */
+} dirVisited_t;
+
+/* all the entries of a directory */
+typedef struct dirList {
+	char            *names;			/* entry names, NUL terminated */
+	size_t           namesLen;
+	size_t           namesSize;
+	dirItem_t       *items;
+	int              count;
+	int              size;
+	int              next;			/* next item to be visited */
+	int              openFds;		/* sub-directories opened in advance */
+} dirList_t;
+
+#ifdef	HAVE_IO_URING
+/* io_uring instance, driven with raw system calls */
+typedef struct dirUring {
+	int              fd;
+	unsigned         entries;		/* submission queue size */
+	/* submission queue */
+	unsigned        *sqHead;
+	unsigned        *sqTail;
+	unsigned        *sqMask;
+	unsigned        *sqArray;
+	struct io_uring_sqe *sqes;
+	/* completion queue */
+	unsigned        *cqHead;
+	unsigned        *cqTail;
+	unsigned        *cqMask;
+	struct io_uring_cqe *cqes;
+	/* mappings */
+	void            *sqRing;
+	void            *cqRing;
+	size_t           sqRingSize;
+	size_t           cqRingSize;
+	size_t           sqesSize;
+	struct statx    *stx;			/* statx buffers, one per submission slot */
+} dirUring_t;
+#endif	/* HAVE_IO_URING */
+
+/* descriptor of a directory whose sub-directories are queued, they are
+ * opened relative to it (freed once none of them needs it any more)
+ */
+typedef struct dirHandle {
+	int              fd;
+	int              refs;			/* tasks not opened yet + the frame (atomic) */
+	int             *count;			/* handles open, dirWalk_t.handleCnt */
+} dirHandle_t;
+
+/* directory being read by the iterative traversal */
+typedef struct dirFrame {
+	dirReader_t      reader;
+	dirHandle_t     *handle;		/* queued sub-directories are opened relative to it (NULL - none) */
+	dirList_t       *list;			/* entries read in advance (NULL - from the stream) */
+	size_t           pathLen;		/* length of the directory pathname in the path buffer */
+	int              delimiter;		/* put before entry names (0 - pathname ends with one) */
+	int              level;
+	int              count;			/* # of entries found */
+	BOOL             bPartial;		/* the list is short of the entries left in the stream (no memory) */
+	int              chunkAt;		/* DIRINFO_CHUNKS: entries streamed before the rest is read & chunked (0 - not) */
+	/* descriptor let go while deeper levels are read (dirWalk_t.fdFrames) */
+	BOOL             bListOnly;		/* every entry left is in the list, the stream is not read */
+	BOOL             bParked;		/* reopened on the way back */
+	dev_t            dev;
+	ino_t            ino;
+} dirFrame_t;
+
+#define	DIRINFO_FD_FRAMES	4096		/* most directory levels holding a descriptor */
+
+/* traversal state shared by all levels of one dirinfo_Find() call */
+typedef struct dirWalk {
+	dirInfo_t       *dip;
+	matchCriteria_t *mcbuf;
+	int              recursive;
+	int              maxLevel;
+	int              baseLevel;		/* level of the top directory */
+	OutputFunc       dbgOutput;
+	BOOL             bNeedPath;		/* someone needs the full pathname */
+	BOOL             bTypeOnly;		/* d_type will do for the file status */
+	BOOL             bFollow;		/* follow symbolic links */
+	int              dirOpenFlags;	/* open() flags of directories */
+	dirVisited_t    *visited;		/* directories read (NULL - not tracked) */
+	dirVisited_t     visitedSet;	/* own set, unless shared by workers */
+	BOOL             bOneFs;		/* do not cross mount points */
+	dev_t            rootDev;		/* device of the top directory */
+	BOOL             bSizes;		/* add up bytes & blocks (DIRINFO_SIZES) */
+	int              statNeeds;		/* stat fields of entry handles (DIRINFO_NEED_xxx) */
+	/* getdents64() record buffers, one per depth (smaller further down) */
+	char           **direntBufs;
+	int              direntBufCnt;
+	size_t           direntBufSize;	/* 0 - use readdir() */
+	/* stack of directories being read, deepest on top */
+	dirFrame_t      *frames;
+	int              frameTop;
+	int              frameCnt;
+	int              fdFrames;		/* frames keeping their descriptor, the ones below let it go */
+	/* descriptors kept for queued sub-directories (dirHandle_t) */
+	int              handles;
+	int             *handleCnt;		/* &handles, or the count shared by the workers */
+	int              handleMax;		/* beyond, sub-directories are read right away */
+	/* pathname of the current entry */
+	char            *path;
+	size_t           pathSize;
+	/* breadth-first frontier, circular buffer of directories to be read */
+	struct dirTask **frontier;
+	int              frontHead;
+	int              frontCount;
+	int              frontSize;
+	int              frontMax;		/* 0 - depth first */
+	/* entries read in advance, one list per depth */
+	dirList_t      **lists;
+	int              listCnt;
+	int              openFds;		/* sub-directories opened in advance */
+	BOOL             bUring;		/* stat & open through io_uring */
+	struct dirUring *uring;
+	BOOL             bInodeOrder;	/* stat in inode order */
+	dirOrder_t      *order;			/* list items sorted by inode */
+	int              orderSize;
+	/* entries of a directory handed over to batchProc, struct of arrays */
+	BOOL             bBatch;
+	dirBatch_t       batch;
+	int              batchSize;		/* entries the arrays hold */
+	int              chunkSize;		/* DIRINFO_CHUNKS, big lists are split for the workers (0 - no) */
+	BOOL             bDevices;		/* sub-directories are stat'ed for their device (deviceMax) */
+	/* DIRINFO_FS_POLICY, policy of the last file system entered */
+	BOOL             bFsPolicy;
+	dev_t            fsDev;
+	const dirFsPolicy_t *fsPolicy;	/* NULL - unknown type, the defaults */
+	/* a callback returned DIRINFO_STOP, or the traversal is cut short */
+	int              stopped;
+	volatile int    *stop;			/* &stopped, or the flag shared by the workers */
+	unsigned         ticks;			/* entries visited, the deadline is checked every so often */
+	/* parallel traversal */
+	struct dirWorker *worker;		/* sub-directories are queued (NULL - recursion) */
+	pthread_mutex_t  *cbLock;		/* held around callbacks (NULL - not serialized) */
+} dirWalk_t;
+
+/* directory to be traversed by a worker */
+typedef struct dirTask {
+	struct dirTask  *parent;
+	int              pending;		/* this directory + its sub-directories not done yet */
+	int              level;
+	int              delimiter;		/* between path and entry names (0 - path ends with one) */
+	int              dfd;			/* already opened (-1 - open it) */
+	dirHandle_t     *parentDir;		/* opened relative to the parent (NULL - by pathname, the top one) */
+	size_t           nameOff;		/* name in the parent, &path[nameOff] */
+	BOOL             visited;		/* entries were read, postFunc is due */
+	struct stat      sb;			/* directory status for postFunc */
+	/* DIRINFO_ORDERED */
+	int              state;			/* TASK_QUEUED, TASK_READING or TASK_READ */
+	int              refs;			/* held by the deque and by the parent (freed at 0) */
+	BOOL             cancelled;		/* not to be visited, read ahead for nothing */
+	struct dirList  *list;			/* entries read ahead (NULL - the directory was not read) */
+	struct dirTask **children;		/* sub-directory read ahead, per entry (NULL - none) */
+	dirHandle_t     *ownDir;		/* this directory, for the sub-directories not read ahead (NULL - none) */
+	BOOL             ahead;			/* claimed by a worker, counted in pool->ahead */
+	/* matchCriteria_t.deviceMax */
+	dev_t            dev;			/* device of the directory (the parent's unless stat'ed) */
+	BOOL             bSlot;			/* holds a worker slot of the device */
+	struct dirTask  *parked;		/* next task waiting for the device */
+	size_t           pathLen;		/* strlen(path) */
+	char             path[1];		/* full pathname (allocated along with the task) */
+} dirTask_t;
+
+/* work-stealing deque, circular buffer */
+typedef struct dirDeque {
+	pthread_mutex_t  lock;
+	dirTask_t      **tasks;
+	int              head;			/* oldest task, stolen first */
+	int              count;
+	int              size;
+} dirDeque_t;
+
+/* list of a big directory stat'ed by several workers (DIRINFO_CHUNKS) */
+typedef struct dirChunks {
+	struct dirChunks *next;			/* other lists being stat'ed (dirPool_t.chunks) */
+	dirList_t       *list;
+	int              dfd;			/* the directory */
+	BOOL             bAll;			/* stat every item, not only the ones needed */
+	int              chunkSize;
+	int              chunkCnt;
+	int              nextChunk;		/* next chunk to be taken */
+	int              busy;			/* chunks being stat'ed */
+} dirChunks_t;
+
+/* device the workers are limited on (matchCriteria_t.deviceMax) */
+typedef struct dirDevice {
+	dev_t            dev;
+	int              running;		/* tasks of the device being run */
+	dirTask_t       *parkHead;		/* tasks waiting for a worker slot */
+	dirTask_t       *parkTail;
+} dirDevice_t;
+
+/* workers of one dirinfo_FindParallel() call */
+typedef struct dirPool {
+	struct dirWorker *workers;
+	int              nworkers;
+	pthread_mutex_t  lock;			/* protects the counters below and dirTask_t.pending */
+	pthread_cond_t   cond;			/* tasks queued or traversal done */
+	long             queued;		/* tasks waiting in deques */
+	long             outstanding;	/* tasks queued or running */
+	pthread_mutex_t  cbLock;		/* DIRINFO_SERIALIZE */
+	dirVisited_t     visited;		/* DIRINFO_FOLLOW, shared by the workers */
+	pthread_mutex_t  visitedLock;
+	int              handles;		/* dirHandle_t open, shared by the workers */
+	volatile int     stopped;		/* a callback returned DIRINFO_STOP, or cut short */
+	dirChunks_t     *chunks;		/* DIRINFO_CHUNKS, lists with chunks left to be taken */
+	int              deviceMax;		/* workers on one device at a time (0 - no limit) */
+	dirDevice_t     *devices;
+	int              deviceCnt;
+	int              deviceSize;
+	/* DIRINFO_ORDERED, workers[0] is the sequencer making the callbacks */
+	BOOL             ordered;
+	BOOL             done;			/* the sequencer is done, workers may go */
+	size_t           buffered;		/* bytes of the entries read, not yet visited */
+	size_t           bufferMax;		/* matchCriteria_t.prefetchMem */
+	int              ahead;			/* directories read ahead by the workers, not entered yet */
+	int              aheadMax;		/* matchCriteria_t.prefetchMax (0 - no limit) */
+	/* DIRINFO_ADAPTIVE, workers[active..] wait (protected by lock) */
+	BOOL             adaptive;
+	int              active;		/* workers at work */
+	int              step;			/* direction of the last change, +1 or -1 */
+	double           lastRate;		/* entries per second in the last interval */
+	long long        sampleAt;		/* start of the interval (msec) */
+	unsigned long    sampleEntries;	/* entries visited at the start */
+} dirPool_t;
+
+#define	DIRINFO_ADAPT_MSEC	200		/* interval between changes of the active workers */
+#define	DIRINFO_ADAPT_TICKS	256		/* entries between looks at the clock */
+
+#define	TASK_QUEUED		0			/* waiting in a deque */
+#define	TASK_READING	1			/* being read ahead */
+#define	TASK_READ		2			/* entries are in the list */
+
+typedef struct dirWorker {
+	dirPool_t       *pool;
+	int              id;
+	pthread_t        tid;
+	dirDeque_t       deque;
+	dirWalk_t        walk;			/* private traversal state, incl. getdents64 buffers */
+	dirInfo_t        info;			/* private statistics, added up at the end */
+	dirTask_t       *task;			/* task being run */
+	int              count;			/* # of entries found */
+	unsigned long    entries;		/* entries visited, read by adaptPool() (DIRINFO_ADAPTIVE) */
+} dirWorker_t;
+
+/* local functions
+ */
+static void initWalk(dirWalk_t *wp, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel);
+static int findAt(dirWalk_t *wp, int dfd, const char *dirname, int delimiter, int curLevel);
+static int pushFrame(dirWalk_t *wp, int dfd, const char *dirname, size_t dirLen, int delimiter, int level);
+static void popFrame(dirWalk_t *wp);
+static void parkFrame(dirWalk_t *wp, dirFrame_t *fp, int depth);
+static int unparkFrame(dirWalk_t *wp, dirFrame_t *fp, int childFd);
+static int growPath(dirWalk_t *wp, size_t len);
+static dirHandle_t *frameHandle(dirWalk_t *wp, dirFrame_t *fp);
+static dirHandle_t *holdHandle(dirHandle_t *hp);
+static void putHandle(dirHandle_t *hp);
+static int enqueueDir(dirWalk_t *wp, dirHandle_t *hp, const char *path, size_t nameOff, int level);
+static int dequeueDir(dirWalk_t *wp);
+static dirTask_t *newTask(const char *path, int delimiter, int level, dirTask_t *parent);
+static int queueTask(dirWorker_t *wkp, dirTask_t *tp);
+static dirTask_t *takeTask(dirWorker_t *wkp);
+static int openTask(dirWalk_t *wp, dirTask_t *tp);
+static void freeTask(dirTask_t *tp);
+static void runTask(dirWorker_t *wkp, dirTask_t *tp);
+static void finishTask(dirWorker_t *wkp, dirTask_t *tp);
+static void *workerMain(void *arg);
+static void readAheadMain(dirWorker_t *wkp);
+static void readAhead(dirWorker_t *wkp, dirTask_t *tp);
+static int enterTask(dirWorker_t *wkp, dirTask_t *tp);
+static int sequenceTasks(dirWorker_t *wkp, dirTask_t *root);
+static dirTask_t *childTask(dirPool_t *pool, dirTask_t *tp, const char *path, int refs);
+static void dropTask(dirPool_t *pool, dirTask_t *tp);
+static void releaseTask(dirPool_t *pool, dirTask_t *tp);
+static void cancelChildren(dirPool_t *pool, dirTask_t *tp);
+static void freeList(dirPool_t *pool, dirTask_t *tp);
+static void destroyTask(dirPool_t *pool, dirTask_t *tp);
+static BOOL aheadFull(dirPool_t *pool);
+static size_t listBytes(const dirTask_t *tp);
+static BOOL deviceEnter(dirPool_t *pool, dirTask_t *tp);
+static void adaptCount(dirWorker_t *wkp);
+static void adaptPool(dirWorker_t *wkp);
+static long long monoMsec(void);
+static dirTask_t *deviceLeave(dirPool_t *pool, dirTask_t *tp);
+static char *direntBuffer(dirWalk_t *wp, int depth, size_t *sizep);
+static size_t direntBufLen(dirWalk_t *wp, int depth);
+static void walkError(dirWalk_t *wp, const char *path, const char *what, int err);
+static int checkCriteria(const char *dirname, matchCriteria_t *mcbuf);
+static void freeWalk(dirWalk_t *wp);
+static void swapBuffers(dirWalk_t *wp, dirWalk_t *keep);
+static int readList(dirWalk_t *wp, dirFrame_t *fp, int depth);
+static const char *nextEntry(dirFrame_t *fp, int *typep, ino_t *inop, size_t *lenp, dirItem_t **itemp);
+static size_t itemNameLen(const dirList_t *lp, int ix);
+static void closeList(dirWalk_t *wp, dirFrame_t *fp);
+static int inodeList(dirWalk_t *wp, dirFrame_t *fp);
+static void statList(dirWalk_t *wp, dirList_t *lp, int dfd, BOOL bAll);
+static void statRange(dirWalk_t *wp, dirList_t *lp, int dfd, BOOL bAll, int first, int last);
+static void chunkList(dirWalk_t *wp, dirList_t *lp, int dfd, BOOL bAll, int chunkSize);
+static int statChunk(dirWalk_t *wp, dirPool_t *pool, dirChunks_t *cp);
+static BOOL chunksLeft(dirPool_t *pool);
+static const dirFsPolicy_t *fsPolicy(dirWalk_t *wp, int dfd, dev_t dev);
+static int policyChunk(dirWalk_t *wp, const dirFsPolicy_t *pp);
+static int batchList(dirWalk_t *wp, dirList_t *lp, const char *dirpath, int dfd, int level);
+static int growBatch(dirWalk_t *wp, int count);
+static int compareInode(const void *p1, const void *p2);
+#ifdef	HAVE_IO_URING
+static dirUring_t *uringOpen(unsigned entries);
+static void uringClose(dirUring_t *urp);
+static struct io_uring_sqe *uringPrep(dirUring_t *urp, unsigned slot, int opcode, int dfd, const char *name, uint64_t userData);
+static int uringList(dirWalk_t *wp, dirFrame_t *fp);
+static unsigned uringReap(dirWalk_t *wp, dirList_t *lp);
+static void uringDrain(dirWalk_t *wp, dirList_t *lp, unsigned pending);
+#endif	/* HAVE_IO_URING */
+static int openReader(dirReader_t *rp, int dfd, char *buf, size_t bufsize);
+static const char *readEntry(dirReader_t *rp, int *typep, ino_t *inop);
+static void closeReader(dirReader_t *rp);
+static const char *modeString(mode_t mode);
+static int neededFields(matchCriteria_t *mcbuf);
+static int typeStat(int type, ino_t ino, struct stat *sbp);
+static int mustStat(dirWalk_t *wp, int type);
+static int visitedAdd(dirVisited_t *vp, dev_t dev, ino_t ino);
+static void visitedFree(dirVisited_t *vp);
+#endif	/* !_MSC_VER */
+static int startFind(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel, void *buffers);
+static int findDir(size_t dirLen, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel, dirFind_t *fsp);
+static size_t findPath(dirFind_t *fsp, size_t dirLen, const char *name, size_t nameLen);
+static int pathDelimiter(void);
+static int callbackAction(int rc);
+static int mustEnd(matchCriteria_t *mcbuf, unsigned *ticksp);
+static int statNeeds(matchCriteria_t *mcbuf);
+static void countEntry(dirInfo_t *dip, const struct stat *sbp, int depth, BOOL bSizes);
+static void addInfo(dirInfo_t *dip, const dirInfo_t *from);
+static void jsonString(const char *str);
+static int utf8Length(const unsigned char *cp);
+#if	!defined(_WIN32) && !defined(__CYGWIN32__)
+static int entryStatAt(dirEntry_t *entp, int flags);
+#endif	/* !_WIN32 && !__CYGWIN32__ */
+#ifdef	HAVE_STATX
+static unsigned statxMask(int needs);
+static void statxToStat(const struct statx *stxp, struct stat *sbp);
+static int statxEntry(dirEntry_t *entp, int flags);
+#endif	/* HAVE_STATX */
+
 /* public functions
  */
 /*
@@ -50,6 +533,9 @@
  * - Callback function will be called if provided in matchCriteria structure.
  * - Collected statistics will be recorded in dirInfo structure.
  * - Depends on the recursive flag, this function could recursively calls itself.
+ * - Callbacks return DIRINFO_CONTINUE, DIRINFO_SKIP_SUBTREE or DIRINFO_STOP;
+ *   once stopped, every directory still open is closed on the way back.
+ * - DIRINFO_ONE_FS: mount points below dirname are reported but not entered.
  *
 dirinfo_Find(
 	const char      *dirname,		// directory name
@@ -60,6 +546,133 @@ dirinfo_Find(
 	int              curLevel)		// current recursive level
  */
 int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel)
+{
+	return startFind(dirname, dip, mcbuf, recursive, maxLevel, curLevel, NULL);
+}
+
+/*
+ * Set up a traversal context: no callbacks, not recursive, no statistics yet
+ */
+void dirinfo_CtxInit(dirinfo_Ctx *ctx)
+{
+	memset(ctx, 0, sizeof(dirinfo_Ctx));
+}
+
+/*
+ * Traverse provided path with the options of the context
+ *
+ * - Same as dirinfo_Find(), or dirinfo_FindParallel() if ctx->threads > 1.
+ * - Statistics are added to ctx->stats.
+ * - The buffers of the traversal are kept in the context for the next one
+ *   (dirinfo_Find() only, the workers of dirinfo_FindParallel() have their own).
+ *
+ * Return: # of entries found, -1 if dirname cannot be opened
+ */
+int dirinfo_CtxFind(dirinfo_Ctx *ctx, const char *dirname)
+{
+	if (ctx->threads > 1) {
+		return dirinfo_FindParallel(dirname, &ctx->stats, &ctx->mc, ctx->recursive, ctx->maxLevel, 0, ctx->threads);
+	}
+#ifndef	_MSC_VER
+	if (ctx->buffers == NULL) {
+		ctx->buffers = calloc(1, sizeof(dirWalk_t));	/* none kept if no memory */
+	}
+#endif	/* !_MSC_VER */
+	return startFind(dirname, &ctx->stats, &ctx->mc, ctx->recursive, ctx->maxLevel, 0, ctx->buffers);
+}
+
+/*
+ * Release the buffers kept in the context (the options and statistics stay)
+ */
+void dirinfo_CtxFree(dirinfo_Ctx *ctx)
+{
+#ifndef	_MSC_VER
+	if (ctx->buffers) {
+		freeWalk((dirWalk_t *) ctx->buffers);
+		free(ctx->buffers);
+	}
+#endif	/* !_MSC_VER */
+	ctx->buffers = NULL;
+}
+
+/*
+ * Traverse provided path (dirinfo_Find, dirinfo_CtxFind)
+ *
+ * Everything shared by the levels of the traversal is set up here, on the
+ * stack of the caller, so that concurrent traversals do not interfere.
+ */
+static int startFind(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel, void *buffers)
+{
+	dirFind_t   find;
+	struct stat sb;
+	int         count;
+
+	if (checkCriteria(dirname, mcbuf) != 0) return -1;
+	memset(&find, 0, sizeof(find));
+	find.baseLevel = curLevel;
+	find.delimiter = pathDelimiter();
+	find.buffers   = buffers;
+	if (mcbuf && (mcbuf->flags & DIRINFO_SIZES)) find.bSizes = TRUE;
+
+	/* DIRINFO_ONE_FS: the device every directory entered has to be on */
+	if (mcbuf && (mcbuf->flags & DIRINFO_ONE_FS) && (stat(dirname, &sb) == 0)) {
+		find.bOneFs  = TRUE;
+		find.rootDev = sb.st_dev;
+	}
+	/* the path buffer, names are appended to it while going down */
+	if (findPath(&find, 0, dirname, strlen(dirname)) == 0) {
+		if (mcbuf && mcbuf->printf)
+			mcbuf->printf(OUT_WARN, "%s: no memory for the pathname\n", dirname);
+		return -1;
+	}
+	count = findDir(strlen(dirname), dip, mcbuf, recursive, maxLevel, curLevel, &find);
+	free(find.path);
+
+	/* cancelled or timed out, the statistics are partial */
+	if (dip && (find.stopped > 0)) dip->interrupted = find.stopped;
+	return count;
+}
+
+/*
+ * Append name to the directory pathname of dirLen characters in the path
+ * buffer (with a delimiter unless it ends with one), growing it as needed
+ *
+ * Return: length of the new pathname, 0 if out of memory
+ */
+static size_t findPath(dirFind_t *fsp, size_t dirLen, const char *name, size_t nameLen)
+{
+	size_t offset = dirLen;
+	size_t len;
+
+	if ((dirLen > 0) && (fsp->path[dirLen - 1] != (char) fsp->delimiter)) offset++;
+	len = offset + nameLen;
+	if (len >= fsp->pathSize) {
+		size_t newSize = (fsp->pathSize) ? fsp->pathSize : PATH_MAX+1;
+		char  *newPath;
+
+		while (len >= newSize) newSize *= 2;
+		if ((newPath = (char *) realloc(fsp->path, newSize)) == NULL) return 0;
+		fsp->path     = newPath;
+		fsp->pathSize = newSize;
+	}
+	if (offset > dirLen) fsp->path[dirLen] = (char) fsp->delimiter;
+	memcpy(&fsp->path[offset], name, nameLen + 1);
+	return len;
+}
+
+/*
+ * Traverse provided path (dirinfo_Find)
+ *
+ * The directory is the first dirLen characters of fsp->path.  The name of
+ * every entry is appended to it in place and cut off again, so the full
+ * pathnames are not composed from scratch.  The buffer may move when it
+ * grows, so dirname is taken again after the entries.
+ * fsp->stopped is set once a callback returns DIRINFO_STOP, or the traversal
+ * is cancelled or timed out, which ends the recursion all the way up.
+ * Sub-directories on another device than fsp->rootDev are not entered
+ * (fsp->bOneFs).
+ */
+static int findDir(size_t dirLen, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel, dirFind_t *fsp)
 {
 #ifdef	_MSC_VER
 	HANDLE          hFile = NULL;	/* Find file handle */
@@ -69,31 +682,50 @@ int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, in
 	DIR             *dirp;			/* directory stream */
 	struct dirent   *direntp;		/* pointer to directory entry structure */
 #endif	/* _MSC_VER */
-	char            fullname[PATH_MAX+1];		/* plus "\0" */
+	const char      *dirname = fsp->path;	/* the directory (NUL terminated at dirLen) */
+	char            *fullname;		/* full pathname of the entry (fsp->path) */
+	size_t          nameLen, pathLen;
 	struct stat     sb;
 	int             count = 0;		/* for debug purpose */
-	static char     sDelimiter = 0;	/* path delimiter */
+	int             action;			/* what the callbacks want (DIRINFO_CONTINUE, ...) */
+	char            delimiter = (char) fsp->delimiter;	/* path delimiter */
 	BOOL     		bEndDelimiter;	/* provided dirname ends with delimiter */
 	OutputFunc      dbgOutput = NULL;
-
-	/* determine delimiter */
-	if (sDelimiter == 0)
-	{
-#ifdef	_MSC_VER
-		sDelimiter = (getenv("SHLVL") == NULL) ? '\\' : '/';
-#else	/* non-MSDOS */
-		sDelimiter = '/';
-#endif	/* _MSC_VER */
-	}
+#ifndef	_MSC_VER
+	BOOL            bTypeOnly = (neededFields(mcbuf) == DIRINFO_NEED_TYPE) ? TRUE : FALSE;
+	BOOL            bStatDone;		/* sb holds the real file status */
+#endif	/* !_MSC_VER */
 
 	/* is provided dirname ends with a delimiter? */
-	bEndDelimiter = (dirname[(strlen(dirname)-1)] == sDelimiter) ? TRUE : FALSE;
+	bEndDelimiter = ((dirLen > 0) && (dirname[dirLen-1] == delimiter)) ? TRUE : FALSE;
 
 	/* enable debug output function if exists */
 	if (mcbuf && mcbuf->printf) {
 		dbgOutput = mcbuf->printf;
 	}
 
+#ifndef	_MSC_VER
+	/* fd-relative traversal */
+	if (mcbuf && ((mcbuf->flags & (DIRINFO_FDRELATIVE | DIRINFO_GETDENTS)) || mcbuf->batchProc)) {
+		dirWalk_t walk;
+		int dfd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dfd < 0) {
+			if (dbgOutput)
+				dbgOutput(OUT_WARN, "%s: error opening directory\n", dirname);
+			return -1;
+		}
+		initWalk(&walk, dip, mcbuf, recursive, maxLevel, curLevel);
+		walk.bOneFs  = fsp->bOneFs;
+		walk.rootDev = fsp->rootDev;
+		if (fsp->buffers) swapBuffers(&walk, (dirWalk_t *) fsp->buffers);	/* buffers of the last traversal */
+		count = findAt(&walk, dfd, dirname, (bEndDelimiter == TRUE) ? 0 : delimiter, curLevel);
+		fsp->stopped = walk.stopped;
+		if (fsp->buffers) swapBuffers(&walk, (dirWalk_t *) fsp->buffers);	/* kept for the next one */
+		freeWalk(&walk);
+		return count;
+	}
+#endif	/* !_MSC_VER */
+
 #ifdef	_MSC_VER
 	if (IsDirectory(dirname) == 0) {
 		if (mcbuf && mcbuf->printf)
@@ -129,8 +761,8 @@ int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, in
 			sprintf(extFileName, "%s*.*", dirname);
 		}
 		else {
-			sprintf(extFileName, "%s%c*.*", dirname, sDelimiter);
-			// swprintf((wchar_t*)extFileName, (const wchar_t*)"%s%c*.*", dirname, sDelimiter);
+			sprintf(extFileName, "%s%c*.*", dirname, delimiter);
+			// swprintf((wchar_t*)extFileName, (const wchar_t*)"%s%c*.*", dirname, delimiter);
 		}
 
 		/* debug */
@@ -151,7 +783,7 @@ int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, in
 				dbgOutput(OUT_NOISE, "FindFirst[cFileName]=%s[%s]\n", dirname, FileData.cFileName);
 			}
 			else {
-				dbgOutput(OUT_NOISE, "FindFirst[cFileName]=%s%c[%s]\n", dirname, sDelimiter, FileData.cFileName);
+				dbgOutput(OUT_NOISE, "FindFirst[cFileName]=%s%c[%s]\n", dirname, delimiter, FileData.cFileName);
 			}
 		}
 
@@ -160,12 +792,9 @@ int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, in
 		if ((strcmp(FileData.cFileName, ".") != 0) &&
 			(strcmp(FileData.cFileName,"..") != 0)) {
 			/* statistics */
-			if (dip) {
-				sprintf(fullname, "%s%c%s", dirname, sDelimiter, FileData.cFileName);
-				stat(fullname, &sb);
-				if (S_ISDIR(sb.st_mode)) dip->num_of_directories++;
-				else if (S_ISREG(sb.st_mode)) dip->num_of_files++;
-				else dip->num_of_others++;
+			if (dip && findPath(fsp, dirLen, FileData.cFileName, strlen(FileData.cFileName))) {
+				stat(fsp->path, &sb);
+				countEntry(dip, &sb, curLevel - fsp->baseLevel, fsp->bSizes);
 			}
 			count++;		/* for debug purpose */
 		}
@@ -204,21 +833,33 @@ int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, in
 		if (dbgOutput)
 			dbgOutput(OUT_NOISE, "readdir/FindNextFile: direntName=%s\n", direntName);
 
+		/* cancelled or timed out */
+		if ((fsp->stopped = mustEnd(mcbuf, &fsp->ticks)) != 0) break;
+
 		count++;		/* for debug purpose */
 
 		/* let's compose the FULL pathname */
 		/* and acquire the file status */
-		// 2011-02-12 prevent double delimiter
-		if (bEndDelimiter == TRUE) {
-			sprintf(fullname, "%s%s", dirname, direntName);
-		}
-		else {
-			sprintf(fullname, "%s%c%s", dirname, sDelimiter, direntName);
+		nameLen = strlen(direntName);
+		if ((pathLen = findPath(fsp, dirLen, direntName, nameLen)) == 0) {
+			if (dbgOutput)
+				dbgOutput(OUT_WARN, "%s: no memory for the pathname, skipped\n", direntName);
+#ifdef	_MSC_VER
+			fDone = !FindNextFile(hFile, &FileData);
+#endif	/* _MSC_VER */
+			continue;
 		}
+		fullname = fsp->path;
 #if	defined(_WIN32) || defined(__CYGWIN32__)
 		stat(fullname, &sb);
 #else
-		lstat(fullname, &sb);
+		/* the entry type in the directory entry will do if that's all needed */
+		bStatDone = FALSE;
+		if ((bTypeOnly == FALSE) || (typeStat(DIRENT_TYPE(direntp), direntp->d_ino, &sb) != 0) ||
+		    (fsp->bOneFs && recursive && S_ISDIR(sb.st_mode))) {
+			lstat(fullname, &sb);
+			bStatDone = TRUE;
+		}
 #endif	/* _WIN32 || __CYGWIN32__ */
 
 		if (dbgOutput)
@@ -227,8 +868,32 @@ int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, in
 		/* ***
 		 * call provided function ...
 		 * */
+		action = DIRINFO_CONTINUE;
 		if (mcbuf && mcbuf->proc) {
-			int rc = (mcbuf->proc) (direntName, fullname, &sb, mcbuf); 
+			action = callbackAction((mcbuf->proc) (direntName, fullname, &sb, mcbuf));
+		}
+		if (mcbuf && mcbuf->entryProc && (action != DIRINFO_STOP)) {
+			dirEntry_t entry;
+			int rc;
+			memset(&entry, 0, sizeof(entry));
+			entry.name     = direntName;
+			entry.fullpath = fullname;
+			entry.nameLen  = (int) nameLen;
+			entry.pathLen  = (int) pathLen;
+			entry.dirfd    = -1;
+			entry.needs    = statNeeds(mcbuf);
+#ifdef	_MSC_VER
+			entry.statDone = 1;
+			entry.sb       = sb;
+#else
+			entry.type     = DIRENT_TYPE(direntp);
+			if (bStatDone == TRUE) {
+				entry.statDone = 1;
+				entry.sb       = sb;
+			}
+#endif	/* _MSC_VER */
+			rc = callbackAction((mcbuf->entryProc) (&entry, mcbuf));
+			if (rc != DIRINFO_CONTINUE) action = rc;
 		}
 
 		/* brief file information */
@@ -278,13 +943,24 @@ int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, in
 
 		/* statistics */
 		if (dip) {
-			if (S_ISDIR(sb.st_mode)) dip->num_of_directories++;
-			else if (S_ISREG(sb.st_mode)) dip->num_of_files++;
-			else dip->num_of_others++;
+			countEntry(dip, &sb, curLevel - fsp->baseLevel, fsp->bSizes);
+		}
+
+		/* stopped by the callback */
+		if (action == DIRINFO_STOP) {
+			fsp->stopped = STOP_CALLBACK;
+			break;
+		}
+
+		/* mount point, another file system (DIRINFO_ONE_FS) */
+		if (recursive && fsp->bOneFs && S_ISDIR(sb.st_mode) && (sb.st_dev != fsp->rootDev) && (action == DIRINFO_CONTINUE)) {
+			if (dbgOutput)
+				dbgOutput(OUT_INFO, "%s: mount point, skipped\n", fullname);
+			action = DIRINFO_SKIP_SUBTREE;
 		}
 
-		/* recursive ... */
-		if (recursive && S_ISDIR(sb.st_mode))
+		/* recursive ... (unless pruned by the callback) */
+		if (recursive && S_ISDIR(sb.st_mode) && (action == DIRINFO_CONTINUE))
 		{
 
 			if (dbgOutput) {
@@ -298,10 +974,11 @@ int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, in
 				/* the directory could have been removed by the callback
 				 * but the call will return with error when opendir() fails
 				 */
-				int rc = dirinfo_Find(fullname, dip, mcbuf, recursive, maxLevel, curLevel+1);
+				int rc = findDir(pathLen, dip, mcbuf, recursive, maxLevel, curLevel+1, fsp);
 
 			}
 		}
+		if (fsp->stopped) break;
 
 #ifdef	_MSC_VER
 		/* find next file entry */
@@ -311,36 +988,3368 @@ int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, in
 	}
 	/* !_MSC_VER  while ((direntp = readdir(dirp)) != NULL) */
 	/* _MSC_VER   while (!fDone) */
+	dirname = fsp->path;		/* back to the directory, the buffer may have moved */
+	fsp->path[dirLen] = 0;
 
 	if (dbgOutput) {
 		dbgOutput(OUT_NOISE, "dirent count=%d\n", count);
 		dbgOutput(OUT_INFO, "Leaving [%s]\n", dirname);
 	}
 
-#ifndef	_MSC_VER
 	/* close the directory entry */
+#ifdef	_MSC_VER
+	FindClose(hFile);
+#else
 	closedir(dirp);
-#endif	/* !_MSC_VER */
+#endif	/* _MSC_VER */
 
 	/* ***
 	 * call provided callback function for this directory
 	 * */
-	if (mcbuf && mcbuf->postFunc) {
+	if (mcbuf && mcbuf->postFunc && (fsp->stopped == 0)) {
 		int rc;
 		stat(dirname, &sb);
 		rc = (mcbuf->postFunc) (dirname, dirname, &sb, mcbuf); 
+		if (callbackAction(rc) == DIRINFO_STOP) fsp->stopped = STOP_CALLBACK;
 	}
 
 	return count;	/* # of entries found */
 }
 
-/* public functions
+/*
+ * Traverse provided path with a pool of threads
+ *
+ * - Same as dirinfo_Find() except sub-directories are traversed in parallel
+ *   by <threads> workers, the calling thread being one of them.
+ * - Entries are visited in no particular order.  postFunc is still called
+ *   after all the entries in the sub-tree of the directory.
+ * - Callbacks may run concurrently unless DIRINFO_SERIALIZE is set.
+ * - DIRINFO_ORDERED: the calling thread makes every callback, one at a time,
+ *   in the order of dirinfo_Find() (depth first), while the other workers
+ *   read directories & stat entries ahead, in the same order: up to
+ *   prefetchMax directories not entered yet (0 - no limit), as long as the
+ *   entries read and not yet visited take less than prefetchMem bytes
+ *   (either may be passed by a directory per worker reading at the time).
+ *   Sub-directories pruned by the callbacks may have been read for nothing.
+ * - DIRINFO_CHUNKS: a directory is streamed, once chunkSize entries have
+ *   been visited the rest of it is read as a whole and its entries are
+ *   stat'ed in chunks by the idle workers, so that a single big directory
+ *   is not left to one of them.  Small directories are never listed.
+ * - deviceMax: at most that many workers read directories of one device
+ *   (st_dev) at a time, the directories of a busy device wait in a queue
+ *   of their own while the other workers go on with the other devices.
+ * - DIRINFO_ADAPTIVE: <threads> workers are started, fewer of them may be
+ *   at work.  Every DIRINFO_ADAPT_MSEC the entries visited per second are
+ *   measured and the active workers moved up or down by hill climbing,
+ *   back the other way when it got worse.  dirInfo.threads is the number
+ *   of workers at work in the end.
+ * - Statistics are collected per worker and added to dirInfo at the end.
+ * - Falls back to dirinfo_Find() if threads < 2, or if not recursive unless
+ *   DIRINFO_CHUNKS is set.
+ *
+ * Return: # of entries found, -1 if dirname cannot be opened
  */
-void dirinfo_Report(dirInfo_t *dip, char *name)
+int dirinfo_FindParallel(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel, int threads)
+{
+#ifndef	_MSC_VER
+	dirPool_t    pool;
+	dirWorker_t *workers;
+	dirTask_t   *root;
+	dirWalk_t    walk;
+	struct stat  sb;
+	int          dfd;
+	int          ix, started = 1;
+	int          count = 0;
+
+	if ((threads < 2) || (mcbuf == NULL) || ((recursive == 0) && !(mcbuf->flags & DIRINFO_CHUNKS))) {
+		return dirinfo_Find(dirname, dip, mcbuf, recursive, maxLevel, curLevel);
+	}
+	if (checkCriteria(dirname, mcbuf) != 0) return -1;
+
+	if ((dfd = open(dirname, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+		if (mcbuf->printf)
+			mcbuf->printf(OUT_WARN, "%s: error opening directory\n", dirname);
+		return -1;
+	}
+	workers = (dirWorker_t *) calloc(threads, sizeof(dirWorker_t));
+	root = newTask(dirname, (dirname[strlen(dirname)-1] == '/') ? 0 : '/', curLevel, NULL);
+	if (workers == NULL || root == NULL) {
+		/* no memory for the pool, do it alone */
+		if (workers) free(workers);
+		if (root) free(root);
+		close(dfd);
+		return dirinfo_Find(dirname, dip, mcbuf, recursive, maxLevel, curLevel);
+	}
+	root->dfd = dfd;
+
+	/* set up the pool */
+	memset(&pool, 0, sizeof(pool));
+	pool.workers  = workers;
+	pool.nworkers = threads;
+	pthread_mutex_init(&pool.lock, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+	pthread_mutex_init(&pool.cbLock, NULL);
+	pthread_mutex_init(&pool.visitedLock, NULL);
+	pool.visited.lock = &pool.visitedLock;
+	pool.ordered      = (mcbuf->flags & DIRINFO_ORDERED) ? TRUE : FALSE;
+	pool.bufferMax    = (mcbuf->prefetchMem > 0) ? (size_t) mcbuf->prefetchMem : DIRINFO_PREFETCH_MEM;
+	pool.aheadMax     = (mcbuf->prefetchMax > 0) ? mcbuf->prefetchMax : 0;
+
+	pool.deviceMax    = (mcbuf->deviceMax > 0) ? mcbuf->deviceMax : 0;
+	pool.adaptive     = (mcbuf->flags & DIRINFO_ADAPTIVE) ? TRUE : FALSE;
+	pool.active       = (pool.adaptive && (threads > 4)) ? 4 : threads;
+	pool.step         = 1;
+	pool.sampleAt     = monoMsec();
+
+	initWalk(&walk, NULL, mcbuf, recursive, maxLevel, curLevel);
+	if (fstat(dfd, &sb) == 0) {
+		root->dev    = sb.st_dev;
+		walk.rootDev = sb.st_dev;
+	}
+	else walk.bOneFs = FALSE;
+	walk.bDevices  = (pool.deviceMax > 0) ? TRUE : FALSE;
+	walk.bNeedPath = TRUE;		/* tasks carry their pathname */
+	walk.frontMax  = 0;			/* workers share the deques, not a frontier */
+	for (ix = 0; ix < threads; ix++) {
+		dirWorker_t *wkp = &workers[ix];
+		wkp->pool        = &pool;
+		wkp->id          = ix;
+		wkp->walk        = walk;
+		wkp->walk.dip    = &wkp->info;
+		wkp->walk.worker = wkp;
+		wkp->walk.stop   = &pool.stopped;
+		wkp->walk.handleCnt = &pool.handles;
+		if (walk.visited) wkp->walk.visited = &pool.visited;
+		wkp->walk.cbLock = (mcbuf->flags & DIRINFO_SERIALIZE) ? &pool.cbLock : NULL;
+		pthread_mutex_init(&wkp->deque.lock, NULL);
+	}
+
+	if (pool.ordered) {
+		/* the workers read ahead, the callbacks are made right here */
+		for (ix = 1; ix < threads; ix++) {
+			if (pthread_create(&workers[ix].tid, NULL, workerMain, &workers[ix]) != 0) {
+				if (mcbuf->printf)
+					mcbuf->printf(OUT_WARN, "pthread_create failed (errno=%d), %d workers\n", errno, ix);
+				break;
+			}
+			started++;
+		}
+		if (mcbuf->printf)
+			mcbuf->printf(OUT_INFO, "%s: %d workers, ordered\n", dirname, started);
+		count = sequenceTasks(&workers[0], root);
+
+		pthread_mutex_lock(&pool.lock);
+		pool.done = TRUE;
+		pthread_cond_broadcast(&pool.cond);
+		pthread_mutex_unlock(&pool.lock);
+		for (ix = 1; ix < started; ix++) {
+			pthread_join(workers[ix].tid, NULL);
+		}
+
+		/* tasks left in the deques (stopped or pruned) */
+		for (ix = 0; ix < threads; ix++) {
+			dirDeque_t *dqp = &workers[ix].deque;
+			while (dqp->count > 0) {
+				dirTask_t *tp = dqp->tasks[dqp->head];
+				dqp->head = (dqp->head + 1) % dqp->size;
+				dqp->count--;
+				if (--tp->refs == 0) destroyTask(&pool, tp);
+			}
+		}
+		/* and left waiting for their device */
+		for (ix = 0; ix < pool.deviceCnt; ix++) {
+			dirDevice_t *devp = &pool.devices[ix];
+			while (devp->parkHead) {
+				dirTask_t *tp = devp->parkHead;
+				devp->parkHead = tp->parked;
+				if (--tp->refs == 0) destroyTask(&pool, tp);
+			}
+		}
+	}
+	/* the top directory is the first task, then let the workers go */
+	else if (queueTask(&workers[0], root) == 0) {
+		for (ix = 1; ix < threads; ix++) {
+			if (pthread_create(&workers[ix].tid, NULL, workerMain, &workers[ix]) != 0) {
+				if (mcbuf->printf)
+					mcbuf->printf(OUT_WARN, "pthread_create failed (errno=%d), %d workers\n", errno, ix);
+				break;
+			}
+			started++;
+		}
+		if (mcbuf->printf)
+			mcbuf->printf(OUT_INFO, "%s: %d workers\n", dirname, started);
+		workerMain(&workers[0]);
+		for (ix = 1; ix < started; ix++) {
+			pthread_join(workers[ix].tid, NULL);
+		}
+	}
+	else {
+		close(dfd);
+		free(root);
+	}
+
+	/* add up statistics and clean up */
+	if (pool.adaptive && (pool.active < started)) started = pool.active;
+	if (pool.adaptive && mcbuf->printf)
+		mcbuf->printf(OUT_INFO, "%s: %d workers at the end\n", dirname, started);
+	if (dip && (pool.stopped > 0)) dip->interrupted = pool.stopped;	/* partial */
+	if (dip) dip->threads = started;
+	for (ix = 0; ix < threads; ix++) {
+		dirWorker_t *wkp = &workers[ix];
+		if (dip) addInfo(dip, &wkp->info);
+		if (pool.ordered == FALSE) count += wkp->count;
+		freeWalk(&wkp->walk);
+		if (wkp->deque.tasks) free(wkp->deque.tasks);
+		pthread_mutex_destroy(&wkp->deque.lock);
+	}
+	pthread_mutex_destroy(&pool.cbLock);
+	if (pool.devices) free(pool.devices);
+	visitedFree(&pool.visited);
+	pthread_mutex_destroy(&pool.visitedLock);
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.lock);
+	free(workers);
+
+	return count;
+#else
+	return dirinfo_Find(dirname, dip, mcbuf, recursive, maxLevel, curLevel);
+#endif	/* !_MSC_VER */
+}
+
+#ifndef	_MSC_VER
+/* traversal state for the top directory */
+static void initWalk(dirWalk_t *wp, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel)
+{
+	memset(wp, 0, sizeof(dirWalk_t));
+	wp->dip       = dip;
+	wp->mcbuf     = mcbuf;
+	wp->recursive = recursive;
+	wp->maxLevel  = maxLevel;
+	wp->baseLevel = curLevel;
+	wp->dbgOutput = mcbuf->printf;
+	wp->stop      = &wp->stopped;
+	wp->fdFrames  = DIRINFO_FD_FRAMES;
+#ifdef	RLIMIT_NOFILE
+	{
+		/* half of the descriptors for the directory levels, the rest for others */
+		struct rlimit rl;
+		if ((getrlimit(RLIMIT_NOFILE, &rl) == 0) && (rl.rlim_cur != RLIM_INFINITY) && (rl.rlim_cur / 2 < DIRINFO_FD_FRAMES)) {
+			wp->fdFrames = (rl.rlim_cur / 2 > 8) ? (int) (rl.rlim_cur / 2) : 8;
+		}
+	}
+#endif	/* RLIMIT_NOFILE */
+	wp->handleCnt = &wp->handles;
+	wp->handleMax = wp->fdFrames / 2;
+	wp->bNeedPath = (mcbuf->printf || mcbuf->proc || mcbuf->entryProc || mcbuf->batchProc || mcbuf->postFunc) ? TRUE : FALSE;
+	wp->bTypeOnly = (neededFields(mcbuf) == DIRINFO_NEED_TYPE) ? TRUE : FALSE;
+	wp->statNeeds = statNeeds(mcbuf);
+	wp->bSizes    = (mcbuf->flags & DIRINFO_SIZES) ? TRUE : FALSE;
+	wp->dirOpenFlags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+	if (mcbuf->flags & DIRINFO_FOLLOW) {
+		wp->bFollow      = TRUE;
+		wp->dirOpenFlags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+		wp->visited      = &wp->visitedSet;
+	}
+#ifdef	HAVE_GETDENTS64
+	if (mcbuf->flags & DIRINFO_GETDENTS) {
+		wp->direntBufSize = (mcbuf->direntBufSize > 0) ? (size_t) mcbuf->direntBufSize : DIRINFO_DIRENT_BUFSIZE;
+	}
+#endif	/* HAVE_GETDENTS64 */
+#ifdef	HAVE_IO_URING
+	if (mcbuf->flags & DIRINFO_URING) {
+		wp->bUring = TRUE;		/* the instance is set up on first use */
+	}
+#endif	/* HAVE_IO_URING */
+	if (mcbuf->flags & DIRINFO_INODE_ORDER) {
+		wp->bInodeOrder = TRUE;
+	}
+	if (mcbuf->batchProc) {
+		wp->bBatch = TRUE;		/* every directory is read as a whole */
+	}
+	if (mcbuf->flags & DIRINFO_CHUNKS) {
+		wp->chunkSize = (mcbuf->chunkSize > 0) ? mcbuf->chunkSize : DIRINFO_CHUNK_SIZE;	/* with workers only */
+	}
+	if (mcbuf->flags & DIRINFO_ONE_FS) {
+		wp->bOneFs = TRUE;		/* rootDev is set by the caller */
+	}
+#ifdef	__linux__
+	if (mcbuf->flags & DIRINFO_FS_POLICY) {
+		wp->bFsPolicy = TRUE;	/* looked up on the first directory */
+	}
+#endif	/* __linux__ */
+	if (mcbuf->flags & DIRINFO_BFS) {
+		wp->frontMax  = (mcbuf->frontierMax > 0) ? mcbuf->frontierMax : DIRINFO_FRONTIER_MAX;
+		wp->bNeedPath = TRUE;		/* queued directories carry their pathname */
+	}
+}
+#endif	/* !_MSC_VER */
+
+#ifndef	_MSC_VER
+/*
+ * Exchange the buffers of the walk with the ones kept in a context
+ * (dirinfo_CtxFind), before and after the traversal
+ *
+ * Records buffers of another size than the walk wants are let go.
+ */
+static void swapBuffers(dirWalk_t *wp, dirWalk_t *keep)
+{
+	dirWalk_t tmp = *keep;
+	int       ix;
+
+	if (keep->direntBufSize != wp->direntBufSize) {
+		for (ix = 0; ix < keep->direntBufCnt; ix++) {
+			if (keep->direntBufs[ix]) free(keep->direntBufs[ix]);
+		}
+		if (keep->direntBufs) free(keep->direntBufs);
+		tmp.direntBufs   = NULL;
+		tmp.direntBufCnt = 0;
+	}
+	keep->direntBufs    = wp->direntBufs;
+	keep->direntBufCnt  = wp->direntBufCnt;
+	keep->direntBufSize = wp->direntBufSize;
+	keep->frames        = wp->frames;
+	keep->frameCnt      = wp->frameCnt;
+	keep->path          = wp->path;
+	keep->pathSize      = wp->pathSize;
+	keep->lists         = wp->lists;
+	keep->listCnt       = wp->listCnt;
+	keep->order         = wp->order;
+	keep->orderSize     = wp->orderSize;
+	keep->uring         = wp->uring;
+	wp->direntBufs      = tmp.direntBufs;
+	wp->direntBufCnt    = tmp.direntBufCnt;
+	wp->frames          = tmp.frames;
+	wp->frameCnt        = tmp.frameCnt;
+	wp->path            = tmp.path;
+	wp->pathSize        = tmp.pathSize;
+	wp->lists           = tmp.lists;
+	wp->listCnt         = tmp.listCnt;
+	wp->order           = tmp.order;
+	wp->orderSize       = tmp.orderSize;
+	wp->uring           = tmp.uring;
+}
+
+/*
+ * Traverse a directory tree through open file descriptors (DIRINFO_FDRELATIVE)
+ *
+ * - Entries are examined with fstatat() relative to the directory and
+ *   sub-directories are opened with openat(), so the kernel does not have
+ *   to resolve every component of the full pathname for every entry.
+ * - The traversal is iterative: every directory being read is a compact
+ *   frame on an explicit stack, and all the pathnames are composed in one
+ *   growable buffer, so the depth of the tree is not bound by the C stack.
+ * - DIRINFO_BFS: sub-directories are queued in a bounded FIFO frontier and
+ *   read level by level, opened relative to their parent whose descriptor
+ *   is kept meanwhile.  When the frontier is full, or the descriptors kept
+ *   reach wp->handleMax, the sub-directory is read depth first right away.
+ *   postFunc is called when the entries of the directory itself have been
+ *   read.
+ * - The full pathname is composed only when a callback or the debug output
+ *   needs it (fullpath is NULL otherwise).
+ * - delimiter is put between dirname and the entry name (0 - dirname already
+ *   ends with a delimiter).
+ * - dfd is owned by this function and closed before it returns.
+ */
+static int findAt(dirWalk_t *wp, int dfd, const char *dirname, int delimiter, int curLevel)
 {
-	fprintf(stdout, "# of %s directories %d\n", name, dip->num_of_directories);
-	fprintf(stdout, "# of %s files       %d\n", name, dip->num_of_files);
-	fprintf(stdout, "# of %s other types %d\n", name, dip->num_of_others);
+	dirFrame_t      *fp;			/* directory being read (top of the stack) */
+	const char      *direntName;	/* name of current entry (in the record buffer) */
+	int             direntType;		/* d_type of current entry */
+	ino_t           direntIno;		/* d_ino of current entry */
+	size_t          nameLen;		/* strlen(direntName) */
+	char            *pathp = NULL;	/* full pathname (if needed) */
+	size_t          pathLen = 0;
+	struct stat     sb;
+	struct stat     *statp;			/* file status of current entry */
+	dirEntry_t      entry;			/* entry handle */
+	dirItem_t       *item;			/* current entry if read in advance */
+	int             action;			/* what the callbacks want (DIRINFO_CONTINUE, ...) */
+	int             count = -1;		/* # of entries in the top directory */
+	matchCriteria_t *mcbuf = wp->mcbuf;
+	dirInfo_t       *dip = wp->dip;
+	OutputFunc      dbgOutput = wp->dbgOutput;
+
+	if (pushFrame(wp, dfd, dirname, strlen(dirname), delimiter, curLevel) != 0) {
+		return -1;
+	}
+
+	while (((wp->frameTop > 0) || (wp->frontCount > 0)) && (*wp->stop == 0))
+	{
+		if (wp->frameTop == 0) {
+			/* breadth first, the next directory in the frontier */
+			dequeueDir(wp);
+			continue;
+		}
+		fp = &wp->frames[wp->frameTop - 1];
+
+		/* a big directory, the rest of it is stat'ed along with the idle workers */
+		if (fp->chunkAt && (fp->count >= fp->chunkAt)) {
+			if (fp->list == NULL) {
+				readList(wp, fp, wp->frameTop - 1);
+				chunkList(wp, fp->list, fp->reader.fd, FALSE, fp->chunkAt);
+			}
+			fp->chunkAt = 0;
+		}
+
+		if ((direntName = nextEntry(fp, &direntType, &direntIno, &nameLen, &item)) == NULL) {
+			/* end of directory, back to the parent */
+			if ((wp->frameTop == 1) && (count < 0)) count = fp->count;	/* top directory, ends before any queued one */
+			popFrame(wp);
+			continue;
+		}
+
+		/* skip '.' and '..' */
+		if ((direntName[0] == '.' && direntName[1] == 0) ||
+		    (direntName[0] == '.' && direntName[1] == '.' &&
+		     direntName[2] == 0))
+		{
+			continue;
+		}
+
+		/* cancelled or timed out, every worker winds down */
+		if ((*wp->stop == 0) && ((action = mustEnd(mcbuf, &wp->ticks)) != 0)) {
+			*wp->stop = action;
+			break;
+		}
+
+		fp->count++;
+		if (wp->worker && wp->worker->pool->adaptive) adaptCount(wp->worker);
+
+		/* compose the FULL pathname only when it is going to be used */
+		if (wp->bNeedPath == TRUE) {
+			size_t offset  = fp->pathLen + (fp->delimiter ? 1 : 0);
+
+			if (growPath(wp, offset + nameLen) != 0) {
+				if (dbgOutput)
+					dbgOutput(OUT_WARN, "%s: no memory for the pathname, skipped\n", direntName);
+				continue;
+			}
+			if (fp->delimiter) wp->path[fp->pathLen] = (char) fp->delimiter;
+			memcpy(&wp->path[offset], direntName, nameLen + 1);
+			pathp   = wp->path;
+			pathLen = offset + nameLen;
+		}
+
+		/* entry handle, the file status is acquired relative to this directory */
+		entry.name     = direntName;
+		entry.fullpath = pathp;
+		entry.nameLen  = (int) nameLen;
+		entry.pathLen  = (int) pathLen;
+		entry.type     = direntType;
+		entry.dirfd    = fp->reader.fd;
+		entry.needs    = wp->statNeeds;
+		entry.follow   = wp->bFollow;
+		entry.statDone = 0;
+		entry.hasBtime = 0;
+		if (item && (item->statDone == 1)) {
+			/* stat'ed in advance */
+			entry.sb        = item->sb;
+			entry.statDone  = 1;
+			entry.hasBtime  = item->hasBtime;
+			entry.btime     = item->btime;
+			entry.btimeNsec = item->btimeNsec;
+		}
+
+		/* the entry type in the directory entry will do if that's all needed */
+		statp = &sb;
+		if (mustStat(wp, direntType) || (typeStat(direntType, direntIno, &sb) != 0)) {
+			if ((statp = dirinfo_EntryStat(&entry)) == NULL) {
+				if (dbgOutput)
+					dbgOutput(OUT_WARN, "%s: fstatat failed (errno=%d)\n", pathp, errno);
+				continue;
+			}
+		}
+
+		/* ***
+		 * call provided function ...
+		 * */
+		action = DIRINFO_CONTINUE;
+		if (wp->cbLock) {
+			pthread_mutex_lock(wp->cbLock);
+			if (*wp->stop) {
+				/* stopped by another worker meanwhile */
+				pthread_mutex_unlock(wp->cbLock);
+				continue;
+			}
+		}
+		if (mcbuf && mcbuf->proc) {
+			action = callbackAction((mcbuf->proc) (direntName, pathp, statp, mcbuf));
+		}
+		if (mcbuf && mcbuf->entryProc && (action != DIRINFO_STOP)) {
+			int rc = callbackAction((mcbuf->entryProc) (&entry, mcbuf));
+			if (rc != DIRINFO_CONTINUE) action = rc;
+		}
+		if (action == DIRINFO_STOP) *wp->stop = STOP_CALLBACK;
+		if (wp->cbLock) pthread_mutex_unlock(wp->cbLock);
+		if (item && (item->action == DIRINFO_SKIP_SUBTREE) && (action == DIRINFO_CONTINUE)) {
+			action = DIRINFO_SKIP_SUBTREE;		/* pruned by batchProc */
+		}
+
+		/* brief file information */
+		if (dbgOutput)
+			dbgOutput(OUT_INFO, "  %s [%s]\n", pathp, modeString(statp->st_mode));
+
+		/* statistics */
+		if (dip) {
+			countEntry(dip, statp, fp->level - wp->baseLevel, wp->bSizes);
+		}
+
+		/* mount point, another file system (DIRINFO_ONE_FS) */
+		if (wp->recursive && wp->bOneFs && S_ISDIR(statp->st_mode) && (statp->st_dev != wp->rootDev) && (action == DIRINFO_CONTINUE)) {
+			if (dbgOutput)
+				dbgOutput(OUT_INFO, "%s: mount point, skipped\n", pathp);
+			action = DIRINFO_SKIP_SUBTREE;
+		}
+
+		/* recursive ... (unless pruned or stopped by the callback) */
+		if (wp->recursive && S_ISDIR(statp->st_mode) && (action == DIRINFO_CONTINUE))
+		{
+			// 2022-04-07 limit max sub-directory depth */
+			if ((wp->maxLevel == 0) || (fp->level < wp->maxLevel)) {
+				dirHandle_t *hp;
+				int cfd;
+
+				if (wp->worker && ((hp = frameHandle(wp, fp)) != NULL)) {
+					/* leave it to whichever worker takes it, to be opened relative
+					 * to this one (out of descriptors for that, keep it here)
+					 */
+					dirTask_t *tp = newTask(pathp, '/', fp->level+1, wp->worker->task);
+					if (tp) {
+						if (statp != &sb) tp->dev = statp->st_dev;	/* stat'ed, not the type only */
+						tp->parentDir = holdHandle(hp);
+						tp->nameOff   = pathLen - nameLen;
+					}
+					if ((tp == NULL) || (queueTask(wp->worker, tp) != 0)) {
+						if (dbgOutput)
+							dbgOutput(OUT_WARN, "%s: no memory, skipped\n", pathp);
+					}
+					continue;
+				}
+				if ((wp->frontCount < wp->frontMax) && ((hp = frameHandle(wp, fp)) != NULL)) {
+					/* breadth first, read it after the directories queued before
+					 * (opened relative to this one)
+					 */
+					if (enqueueDir(wp, hp, pathp, pathLen - nameLen, fp->level+1) == 0) continue;
+				}
+
+				/* depth first, the sub-directory becomes the top of the stack
+				 * (it could have been removed by the callback in which case
+				 * openat() simply fails)
+				 */
+				if (item && (item->fd >= 0)) {
+					/* opened in advance */
+					cfd = item->fd;
+					item->fd = -1;
+					fp->list->openFds--;
+					wp->openFds--;
+				}
+				else {
+					cfd = openat(fp->reader.fd, direntName, wp->dirOpenFlags);
+				}
+				if (cfd < 0) {
+					if ((errno == EMFILE) || (errno == ENFILE) || (errno == ENOMEM))
+						walkError(wp, pathp, "error opening directory", errno);	/* out of descriptors */
+					else if (dbgOutput)
+						dbgOutput(OUT_WARN, "%s: error opening directory\n", pathp);
+				}
+				else {
+					/* deep down, the descriptor of this one is let go until it is back on top */
+					if ((wp->frameTop >= wp->fdFrames) && (wp->worker == NULL)) parkFrame(wp, fp, wp->frameTop - 1);
+					pushFrame(wp, cfd, NULL, pathLen, '/', fp->level+1);
+				}
+			}
+		}
+	}
+
+	/* stopped, close the directories left open (postFunc is not called) */
+	while (wp->frameTop > 0) {
+		fp = &wp->frames[wp->frameTop - 1];
+		if ((wp->frameTop == 1) && (count < 0)) count = fp->count;
+		popFrame(wp);
+	}
+
+	return count;	/* # of entries found */
+}
+
+/*
+ * Start reading a directory: push a frame on top of the stack
+ *
+ * - The pathname of the directory is copied to the path buffer unless it is
+ *   already there (dirname NULL).
+ * - dfd is closed on error.
+ *
+ * Return:
+ *         0	success
+ *        -1	error, the directory has been visited already (DIRINFO_FOLLOW)
+ *         	or is on a pseudo file system (DIRINFO_FS_POLICY)
+ */
+static int pushFrame(dirWalk_t *wp, int dfd, const char *dirname, size_t dirLen, int delimiter, int level)
+{
+	dirFrame_t          *fp;
+	int                 depth = wp->frameTop;
+	struct stat         sb;
+	BOOL                bStat = FALSE;		/* sb is the status of the directory */
+	const dirFsPolicy_t *pp = NULL;			/* policy of its file system */
+	BOOL                bInode;				/* stat'ed in inode order */
+	char                *buf;				/* for its getdents64() records */
+	size_t              bufSize;
+
+	if (wp->visited || wp->bFsPolicy) {
+		bStat = (fstat(dfd, &sb) == 0) ? TRUE : FALSE;
+	}
+
+	/* following symbolic links, every directory is read once (no cycles) */
+	if (wp->visited && bStat && (visitedAdd(wp->visited, sb.st_dev, sb.st_ino) == 0)) {
+		if (wp->dbgOutput)
+			wp->dbgOutput(OUT_INFO, "%s: visited already, skipped\n", dirname ? dirname : wp->path);
+		close(dfd);
+		return -1;
+	}
+
+	/* how to go about its file system, pseudo ones are only read on purpose */
+	if (wp->bFsPolicy && bStat && ((pp = fsPolicy(wp, dfd, sb.st_dev)) != NULL) &&
+		(pp->flags & DIRFS_PSEUDO) && (level > wp->baseLevel)) {
+		if (wp->dbgOutput)
+			wp->dbgOutput(OUT_INFO, "%s: %s file system, skipped\n", dirname ? dirname : wp->path, pp->name);
+		close(dfd);
+		return -1;
+	}
+
+	if (depth == wp->frameCnt) {
+		int         newCnt = (wp->frameCnt) ? wp->frameCnt * 2 : 16;
+		dirFrame_t *newFrames = (dirFrame_t *) realloc(wp->frames, newCnt * sizeof(dirFrame_t));
+		if (newFrames == NULL) {
+			walkError(wp, dirname ? dirname : wp->path, "no memory for the directory level", ENOMEM);
+			close(dfd);
+			return -1;
+		}
+		wp->frames   = newFrames;
+		wp->frameCnt = newCnt;
+	}
+	if (dirname && wp->bNeedPath) {
+		if (growPath(wp, dirLen) != 0) {
+			close(dfd);
+			return -1;
+		}
+		memcpy(wp->path, dirname, dirLen + 1);
+	}
+
+	/* open the directory stream on top of the descriptor */
+	fp  = &wp->frames[depth];
+	buf = direntBuffer(wp, depth, &bufSize);
+	if (openReader(&fp->reader, dfd, buf, bufSize) != 0) {
+		walkError(wp, dirname ? dirname : wp->path, "error opening directory", errno);
+		close(dfd);
+		return -1;
+	}
+	if (pp && (pp->flags & DIRFS_NO_DTYPE)) fp->reader.bNoType = TRUE;
+	fp->handle    = NULL;
+	fp->list      = NULL;
+	fp->pathLen   = dirLen;
+	fp->delimiter = delimiter;
+	fp->level     = level;
+	fp->count     = 0;
+	fp->bPartial  = FALSE;
+	fp->chunkAt   = 0;
+	fp->bListOnly = FALSE;
+	fp->bParked   = FALSE;
+	wp->frameTop++;
+
+	/* debug */
+	if (wp->dbgOutput)
+		wp->dbgOutput(OUT_INFO, "Entering [%s] (fd=%d%s%s)\n", wp->path, dfd,
+			(fp->reader.dirp == NULL) ? ", getdents64" : "", wp->bUring ? ", io_uring" : "");
+
+#ifdef	HAVE_IO_URING
+	/* read the whole directory, then stat & open its entries in batches */
+	if (wp->bUring) {
+		if ((wp->uring == NULL) && ((wp->uring = uringOpen(DIRINFO_URING_ENTRIES)) == NULL)) {
+			if (wp->dbgOutput)
+				wp->dbgOutput(OUT_WARN, "io_uring is not available (errno=%d), synchronous calls\n", errno);
+			wp->bUring = FALSE;
+		}
+		else {
+			readList(wp, fp, depth);
+			if (uringList(wp, fp) != 0) {
+				/* give up, the entries left are stat'ed synchronously */
+				uringClose(wp->uring);
+				wp->uring  = NULL;
+				wp->bUring = FALSE;
+			}
+		}
+	}
+#endif	/* HAVE_IO_URING */
+
+	/* a big directory is stat'ed along with the idle workers: read as a whole
+	 * if it is anyway, or streamed until chunkSize entries have been visited */
+	bInode = (wp->bInodeOrder || (pp && (pp->flags & DIRFS_INODE_ORDER))) ? TRUE : FALSE;
+	if (policyChunk(wp, pp) && wp->worker && (wp->bUring == FALSE)) {
+		if ((fp->list == NULL) && (bInode == FALSE) && (wp->bBatch == FALSE)) {
+			fp->chunkAt = policyChunk(wp, pp);
+		}
+		else {
+			if (fp->list == NULL) readList(wp, fp, depth);
+			chunkList(wp, fp->list, fp->reader.fd, FALSE, policyChunk(wp, pp));
+		}
+	}
+
+	/* read the whole directory, then stat its entries in inode order */
+	if (bInode && (wp->bUring == FALSE)) {
+		if (fp->list == NULL) readList(wp, fp, depth);
+		inodeList(wp, fp);
+	}
+
+	/* read the whole directory, then hand its entries over in one batch */
+	if (wp->bBatch && (*wp->stop == 0)) {
+		if ((fp->list == NULL) && (readList(wp, fp, depth) != 0) && wp->dbgOutput) {
+			wp->dbgOutput(OUT_WARN, "%s: no memory, entries left out of the batch\n", wp->path);
+		}
+		statList(wp, fp->list, fp->reader.fd, FALSE);
+		if (batchList(wp, fp->list, wp->path, fp->reader.fd, level) == DIRINFO_STOP) *wp->stop = STOP_CALLBACK;
+	}
+	return 0;
+}
+
+/*
+ * All entries of the top directory have been read: call postFunc and
+ * pop the frame
+ */
+static void popFrame(dirWalk_t *wp)
+{
+	dirFrame_t      *fp = &wp->frames[wp->frameTop - 1];
+	matchCriteria_t *mcbuf = wp->mcbuf;
+
+	/* the pathname of the directory itself */
+	if (wp->bNeedPath) wp->path[fp->pathLen] = 0;
+
+	/* cut short by a read error, the entries after it are missing */
+	if (fp->reader.error) walkError(wp, wp->bNeedPath ? wp->path : "(directory)", "error reading directory", fp->reader.error);
+
+	if (wp->dbgOutput) {
+		wp->dbgOutput(OUT_NOISE, "dirent count=%d\n", fp->count);
+		wp->dbgOutput(OUT_INFO, "Leaving [%s]\n", wp->path);
+	}
+
+	/* ***
+	 * call provided callback function for this directory
+	 * */
+	if (mcbuf && mcbuf->postFunc && (*wp->stop == 0)) {
+		if (wp->worker && (wp->frameTop == 1)) {
+			/* called once the queued sub-directories are done as well */
+			fstat(fp->reader.fd, &wp->worker->task->sb);
+		}
+		else {
+			struct stat sb;
+			int rc;
+			if (fstat(fp->reader.fd, &sb) != 0) memset(&sb, 0, sizeof(sb));	/* not reopened */
+			if (wp->cbLock) pthread_mutex_lock(wp->cbLock);
+			if (*wp->stop == 0) {
+				rc = (mcbuf->postFunc) (wp->path, wp->path, &sb, mcbuf);
+				if (callbackAction(rc) == DIRINFO_STOP) *wp->stop = STOP_CALLBACK;
+			}
+			if (wp->cbLock) pthread_mutex_unlock(wp->cbLock);
+		}
+	}
+
+	/* the parent let its descriptor go, back to it through this one */
+	if ((wp->frameTop > 1) && fp[-1].bParked && (*wp->stop == 0)) unparkFrame(wp, &fp[-1], fp->reader.fd);
+
+	/* close the directory entry (and the descriptor, kept for the queued
+	 * sub-directories if any)
+	 */
+	closeList(wp, fp);
+	closeReader(&fp->reader);
+	putHandle(fp->handle);
+	wp->frameTop--;
+}
+
+/*
+ * Let the descriptor of a directory go while its sub-directories are read
+ * (more than wp->fdFrames levels deep): the entries left are read into its
+ * list first, then its device & inode are kept to find it again
+ *
+ * The frame keeps its descriptor if that cannot be done (no memory).
+ */
+static void parkFrame(dirWalk_t *wp, dirFrame_t *fp, int depth)
+{
+	struct stat sb;
+
+	if (fp->bParked) return;
+	if ((fp->list == NULL) && (readList(wp, fp, depth) != 0)) return;
+	if (fp->bPartial || (fstat(fp->reader.fd, &sb) != 0)) return;
+
+	closeReader(&fp->reader);
+	fp->reader.dirp = NULL;
+	fp->reader.fd   = -1;
+	fp->bListOnly   = TRUE;
+	fp->bParked     = TRUE;
+	fp->dev         = sb.st_dev;
+	fp->ino         = sb.st_ino;
+}
+
+/*
+ * Reopen a parked directory, as ".." of its sub-directory (childFd) or by
+ * its pathname, as long as it is the same directory (device & inode)
+ *
+ * Return:
+ *         0	success, fp->reader.fd is open again
+ *        -1	not found again, the entries left are skipped
+ */
+static int unparkFrame(dirWalk_t *wp, dirFrame_t *fp, int childFd)
+{
+	struct stat sb;
+	int         fd;
+	int         ix;
+
+	for (ix = 0; ix < 2; ix++) {
+		if (ix == 0) fd = openat(childFd, "..", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		else if (wp->bNeedPath && (fp->pathLen < PATH_MAX)) {
+			/* following symbolic links, ".." may be another directory */
+			char c = wp->path[fp->pathLen];
+			wp->path[fp->pathLen] = 0;
+			fd = open(wp->path, wp->dirOpenFlags);
+			wp->path[fp->pathLen] = c;
+		}
+		else break;
+		if (fd < 0) continue;
+		if ((fstat(fd, &sb) == 0) && (sb.st_dev == fp->dev) && (sb.st_ino == fp->ino)) {
+			fp->reader.fd = fd;
+			fp->bParked   = FALSE;
+			return 0;
+		}
+		close(fd);
+	}
+
+	/* moved or removed meanwhile */
+	if (wp->bNeedPath) wp->path[fp->pathLen] = 0;
+	walkError(wp, wp->bNeedPath ? wp->path : "(directory)", "cannot be reopened, entries left out", errno);
+	fp->list->next = fp->list->count;
+	return -1;
+}
+
+/*
+ * Add a directory to the tail of the breadth-first frontier, to be opened
+ * relative to its parent (hp) by its name (&path[nameOff])
+ *
+ * Return:
+ *         0	success
+ *        -1	no memory (go depth first)
+ */
+static int enqueueDir(dirWalk_t *wp, dirHandle_t *hp, const char *path, size_t nameOff, int level)
+{
+	dirTask_t *tp;
+
+	if (wp->frontCount == wp->frontSize) {
+		/* grow the circular buffer, up to frontMax */
+		int         ix, newSize = (wp->frontSize) ? wp->frontSize * 2 : 256;
+		dirTask_t **newFrontier;
+
+		if (newSize > wp->frontMax) newSize = wp->frontMax;
+		if ((newFrontier = (dirTask_t **) malloc(newSize * sizeof(dirTask_t *))) == NULL) return -1;
+		for (ix = 0; ix < wp->frontCount; ix++) {
+			newFrontier[ix] = wp->frontier[(wp->frontHead + ix) % wp->frontSize];
+		}
+		if (wp->frontier) free(wp->frontier);
+		wp->frontier  = newFrontier;
+		wp->frontSize = newSize;
+		wp->frontHead = 0;
+	}
+	if ((tp = newTask(path, '/', level, NULL)) == NULL) return -1;
+	tp->parentDir = holdHandle(hp);
+	tp->nameOff   = nameOff;
+
+	wp->frontier[(wp->frontHead + wp->frontCount) % wp->frontSize] = tp;
+	wp->frontCount++;
+	return 0;
+}
+
+/*
+ * Start reading the directory at the head of the breadth-first frontier
+ *
+ * Return:
+ *         0	success
+ *        -1	error (the directory is skipped)
+ */
+static int dequeueDir(dirWalk_t *wp)
+{
+	dirTask_t *tp = wp->frontier[wp->frontHead];
+	int        dfd, rc = -1;
+
+	wp->frontHead = (wp->frontHead + 1) % wp->frontSize;
+	wp->frontCount--;
+
+	if ((dfd = openTask(wp, tp)) >= 0) {
+		rc = pushFrame(wp, dfd, tp->path, tp->pathLen, tp->delimiter, tp->level);
+	}
+	freeTask(tp);
+	return rc;
+}
+
+/* make room for a pathname of len characters in the path buffer */
+static int growPath(dirWalk_t *wp, size_t len)
+{
+	if (len >= wp->pathSize) {
+		size_t newSize = (wp->pathSize) ? wp->pathSize : PATH_MAX+1;
+		char  *newPath;
+
+		while (len >= newSize) newSize *= 2;
+		if ((newPath = (char *) realloc(wp->path, newSize)) == NULL) return -1;
+		wp->path     = newPath;
+		wp->pathSize = newSize;
+	}
+	return 0;
+}
+
+/*
+ * Descriptor of the directory of the frame for its queued sub-directories,
+ * a duplicate the frame holds a reference to until it is popped
+ *
+ * Return:
+ *         the handle
+ *         NULL - out of descriptors (wp->handleMax) or no memory, the
+ *         	sub-directories are read right away
+ */
+static dirHandle_t *frameHandle(dirWalk_t *wp, dirFrame_t *fp)
+{
+	dirHandle_t *hp;
+
+	if (fp->handle) return fp->handle;
+	if (fp->reader.fd < 0) return NULL;
+	if (__atomic_add_fetch(wp->handleCnt, 1, __ATOMIC_RELAXED) > wp->handleMax) {
+		__atomic_sub_fetch(wp->handleCnt, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	if ((hp = (dirHandle_t *) malloc(sizeof(dirHandle_t))) == NULL) {
+		__atomic_sub_fetch(wp->handleCnt, 1, __ATOMIC_RELAXED);
+		return NULL;
+	}
+	if ((hp->fd = fcntl(fp->reader.fd, F_DUPFD_CLOEXEC, 0)) < 0) {
+		__atomic_sub_fetch(wp->handleCnt, 1, __ATOMIC_RELAXED);
+		free(hp);
+		return NULL;
+	}
+	hp->refs   = 1;
+	hp->count  = wp->handleCnt;
+	fp->handle = hp;
+	return hp;
+}
+
+/* one more reference to the handle (if any) */
+static dirHandle_t *holdHandle(dirHandle_t *hp)
+{
+	if (hp) __atomic_add_fetch(&hp->refs, 1, __ATOMIC_RELAXED);
+	return hp;
+}
+
+/* release a reference to the handle (if any), the last one closes it */
+static void putHandle(dirHandle_t *hp)
+{
+	if ((hp == NULL) || (__atomic_sub_fetch(&hp->refs, 1, __ATOMIC_ACQ_REL) > 0)) return;
+	close(hp->fd);
+	__atomic_sub_fetch(hp->count, 1, __ATOMIC_RELAXED);
+	free(hp);
+}
+
+/*
+ * Record buffer for getdents64() at given depth
+ *
+ * Every depth has its own buffer (records of the parent directory must stay
+ * valid while a sub-directory is being read), which is reused by all the
+ * directories at the same depth.  The buffer is halved at every depth down
+ * to DIRENT_DEEP_BUFSIZE, so that a deep tree does not take a full buffer
+ * per level.
+ *
+ * Return:
+ *         the buffer (*sizep bytes)
+ *         NULL - getdents64() is not used or no memory (fall back to readdir)
+ */
+static char *direntBuffer(dirWalk_t *wp, int depth, size_t *sizep)
+{
+	*sizep = 0;
+	if (wp->direntBufSize == 0) return NULL;
+
+	if (depth >= wp->direntBufCnt) {
+		int    newCnt = depth + 8;
+		char **newBufs = (char **) realloc(wp->direntBufs, newCnt * sizeof(char *));
+		if (newBufs == NULL) return NULL;
+		memset(&newBufs[wp->direntBufCnt], 0, (newCnt - wp->direntBufCnt) * sizeof(char *));
+		wp->direntBufs   = newBufs;
+		wp->direntBufCnt = newCnt;
+	}
+	if (wp->direntBufs[depth] == NULL) {
+		wp->direntBufs[depth] = (char *) malloc(direntBufLen(wp, depth));
+	}
+	if (wp->direntBufs[depth]) *sizep = direntBufLen(wp, depth);
+	return wp->direntBufs[depth];
+}
+
+/* size of the getdents64() record buffer at given depth */
+static size_t direntBufLen(dirWalk_t *wp, int depth)
+{
+	size_t size = wp->direntBufSize;
+
+	while ((depth-- > 0) && (size / 2 >= DIRENT_DEEP_BUFSIZE)) size /= 2;
+	return size;
+}
+
+/*
+ * A directory is left out (in part) for lack of memory or descriptors, or
+ * a read error: count it in the statistics (dirInfo_t.errors) and warn
+ */
+static void walkError(dirWalk_t *wp, const char *path, const char *what, int err)
+{
+	if (wp->dip) wp->dip->errors++;
+	if (wp->dbgOutput)
+		wp->dbgOutput(OUT_WARN, "%s: %s (errno=%d)\n", path, what, err);
+}
+
+/* release getdents64() record buffers, directory stack and path buffer */
+static void freeWalk(dirWalk_t *wp)
+{
+	int ix;
+	for (ix = 0; ix < wp->direntBufCnt; ix++) {
+		if (wp->direntBufs[ix]) free(wp->direntBufs[ix]);
+	}
+	if (wp->direntBufs) free(wp->direntBufs);
+	wp->direntBufs   = NULL;
+	wp->direntBufCnt = 0;
+	if (wp->frames) free(wp->frames);
+	wp->frames   = NULL;
+	wp->frameCnt = 0;
+	if (wp->path) free(wp->path);
+	wp->path     = NULL;
+	wp->pathSize = 0;
+	while (wp->frontCount > 0) {
+		freeTask(wp->frontier[wp->frontHead]);
+		wp->frontHead = (wp->frontHead + 1) % wp->frontSize;
+		wp->frontCount--;
+	}
+	if (wp->frontier) free(wp->frontier);
+	wp->frontier  = NULL;
+	wp->frontSize = 0;
+	for (ix = 0; ix < wp->listCnt; ix++) {
+		if (wp->lists[ix] == NULL) continue;
+		if (wp->lists[ix]->names) free(wp->lists[ix]->names);
+		if (wp->lists[ix]->items) free(wp->lists[ix]->items);
+		free(wp->lists[ix]);
+	}
+	if (wp->lists) free(wp->lists);
+	wp->lists   = NULL;
+	wp->listCnt = 0;
+	if (wp->order) free(wp->order);
+	wp->order     = NULL;
+	wp->orderSize = 0;
+	if (wp->batch.nameOff) free(wp->batch.nameOff);
+	if (wp->batch.nameLen) free(wp->batch.nameLen);
+	if (wp->batch.type)    free(wp->batch.type);
+	if (wp->batch.mode)    free(wp->batch.mode);
+	if (wp->batch.size)    free(wp->batch.size);
+	if (wp->batch.mtime)   free(wp->batch.mtime);
+	if (wp->batch.action)  free(wp->batch.action);
+	memset(&wp->batch, 0, sizeof(wp->batch));
+	wp->batchSize = 0;
+	visitedFree(&wp->visitedSet);
+#ifdef	HAVE_IO_URING
+	if (wp->uring) uringClose(wp->uring);
+	wp->uring = NULL;
+#endif	/* HAVE_IO_URING */
+}
+
+/*
+ * Open a directory stream on the descriptor
+ *
+ * With a record buffer, the directory is read with getdents64() directly
+ * (Linux), otherwise through fdopendir() & readdir().
+ *
+ * Return:
+ *         0	success
+ *        -1	error (dfd is NOT closed)
+ */
+static int openReader(dirReader_t *rp, int dfd, char *buf, size_t bufsize)
+{
+	rp->fd   = dfd;
+	rp->bpos = rp->blen = 0;
+	rp->bNoType = FALSE;
+	rp->error   = 0;
+#ifdef	HAVE_GETDENTS64
+	if (buf != NULL) {
+		rp->dirp    = NULL;
+		rp->buf     = buf;
+		rp->bufsize = bufsize;
+		return 0;
+	}
+#endif	/* HAVE_GETDENTS64 */
+	rp->buf     = NULL;
+	rp->bufsize = 0;
+	return ((rp->dirp = fdopendir(dfd)) == NULL) ? -1 : 0;
+}
+
+/*
+ * Next entry of the directory stream
+ *
+ * No copy is made: the returned name points into the record buffer and
+ * stays valid until the next call.
+ *
+ * Return:
+ *         name of the entry (type & inode number are stored in *typep & *inop)
+ *         NULL at the end of the directory, or on error (errno in rp->error)
+ */
+static const char *readEntry(dirReader_t *rp, int *typep, ino_t *inop)
+{
+#ifdef	HAVE_GETDENTS64
+	if (rp->dirp == NULL) {
+		struct linuxDirent64 *ldp;
+
+		if (rp->bpos >= rp->blen) {
+			/* refill the record buffer */
+			rp->blen = syscall(SYS_getdents64, rp->fd, rp->buf, rp->bufsize);
+			rp->bpos = 0;
+			if (rp->blen < 0) {
+				rp->error = errno;
+				rp->blen  = 0;
+			}
+			if (rp->blen <= 0) return NULL;
+		}
+		ldp = (struct linuxDirent64 *) (rp->buf + rp->bpos);
+		rp->bpos += ldp->d_reclen;
+		*typep = (rp->bNoType) ? 0 : ldp->d_type;
+		*inop  = (ino_t) ldp->d_ino;
+		return ldp->d_name;
+	}
+#endif	/* HAVE_GETDENTS64 */
+	{
+		struct dirent *direntp;
+
+		errno = 0;
+		if ((direntp = readdir(rp->dirp)) == NULL) {
+			rp->error = errno;
+			return NULL;
+		}
+		*typep = (rp->bNoType) ? 0 : DIRENT_TYPE(direntp);
+		*inop  = direntp->d_ino;
+		return direntp->d_name;
+	}
+}
+
+/* close the directory stream (and the descriptor) */
+static void closeReader(dirReader_t *rp)
+{
+	if (rp->dirp) closedir(rp->dirp);
+	else close(rp->fd);
+}
+
+/*
+ * Read all the entries of the top directory into its list (DIRINFO_URING)
+ *
+ * Names are copied into the name buffer of the list so that the statx and
+ * openat requests can refer to them while the directory is being visited.
+ *
+ * Return:
+ *         0	success
+ *        -1	no memory (the rest of the directory is read one by one)
+ */
+static int readList(dirWalk_t *wp, dirFrame_t *fp, int depth)
+{
+	dirList_t  *lp;
+	const char *direntName;
+	int         direntType;
+	ino_t       direntIno;
+
+	/* one list per depth, reused by the directories at the same depth */
+	if (depth >= wp->listCnt) {
+		int         newCnt = depth + 8;
+		dirList_t **newLists = (dirList_t **) realloc(wp->lists, newCnt * sizeof(dirList_t *));
+		if (newLists == NULL) return -1;
+		memset(&newLists[wp->listCnt], 0, (newCnt - wp->listCnt) * sizeof(dirList_t *));
+		wp->lists   = newLists;
+		wp->listCnt = newCnt;
+	}
+	if ((wp->lists[depth] == NULL) &&
+		((wp->lists[depth] = (dirList_t *) calloc(1, sizeof(dirList_t))) == NULL)) {
+		return -1;
+	}
+	lp = wp->lists[depth];
+	lp->namesLen = 0;
+	lp->count    = 0;
+	lp->next     = 0;
+	lp->openFds  = 0;
+
+	while ((direntName = readEntry(&fp->reader, &direntType, &direntIno)) != NULL)
+	{
+		size_t     nameLen;
+		dirItem_t *itemp;
+
+		/* skip '.' and '..' */
+		if ((direntName[0] == '.' && direntName[1] == 0) ||
+		    (direntName[0] == '.' && direntName[1] == '.' &&
+		     direntName[2] == 0))
+		{
+			continue;
+		}
+
+		nameLen = strlen(direntName);
+		if (lp->namesLen + nameLen + 1 > lp->namesSize) {
+			size_t newSize = (lp->namesSize) ? lp->namesSize * 2 : 16384;
+			char  *newNames;
+			while (lp->namesLen + nameLen + 1 > newSize) newSize *= 2;
+			if ((newNames = (char *) realloc(lp->names, newSize)) == NULL) break;
+			lp->names     = newNames;
+			lp->namesSize = newSize;
+		}
+		if (lp->count == lp->size) {
+			int        newSize = (lp->size) ? lp->size * 2 : 256;
+			dirItem_t *newItems = (dirItem_t *) realloc(lp->items, newSize * sizeof(dirItem_t));
+			if (newItems == NULL) break;
+			lp->items = newItems;
+			lp->size  = newSize;
+		}
+
+		itemp = &lp->items[lp->count++];
+		itemp->nameOff  = lp->namesLen;
+		itemp->ino      = direntIno;
+		itemp->type     = direntType;
+		itemp->statDone = 0;
+		itemp->hasBtime = 0;
+		itemp->fd       = -1;
+		itemp->action   = DIRINFO_CONTINUE;
+		memcpy(&lp->names[lp->namesLen], direntName, nameLen + 1);
+		lp->namesLen += nameLen + 1;
+	}
+
+	/* on no memory, the entries left are read from the stream after the list */
+	fp->list     = lp;
+	fp->bPartial = (direntName == NULL) ? FALSE : TRUE;
+	return (direntName == NULL) ? 0 : -1;
+}
+
+/*
+ * Next entry of the top directory, from its list or the directory stream
+ *
+ * Return:
+ *         name of the entry (*itemp is NULL if it is not from the list),
+ *         its length in *lenp
+ *         NULL at the end of the directory
+ */
+static const char *nextEntry(dirFrame_t *fp, int *typep, ino_t *inop, size_t *lenp, dirItem_t **itemp)
+{
+	dirList_t  *lp = fp->list;
+	const char *name;
+
+	if (lp && (lp->next < lp->count)) {
+		dirItem_t *item = &lp->items[lp->next];
+		*typep = item->type;
+		*inop  = item->ino;
+		*lenp  = itemNameLen(lp, lp->next++);
+		*itemp = item;
+		return &lp->names[item->nameOff];
+	}
+	*itemp = NULL;
+	if (fp->bListOnly) return NULL;		/* the stream was read to the end */
+	if ((name = readEntry(&fp->reader, typep, inop)) != NULL) *lenp = strlen(name);
+	return name;
+}
+
+/* length of the name of list item ix, the names are packed one after another */
+static size_t itemNameLen(const dirList_t *lp, int ix)
+{
+	size_t nextOff = (ix + 1 < lp->count) ? lp->items[ix + 1].nameOff : lp->namesLen;
+
+	return nextOff - lp->items[ix].nameOff - 1;
+}
+
+/* close the sub-directories opened in advance but not visited */
+static void closeList(dirWalk_t *wp, dirFrame_t *fp)
+{
+	dirList_t *lp = fp->list;
+	int        ix;
+
+	if (lp == NULL) return;
+	for (ix = 0; (lp->openFds > 0) && (ix < lp->count); ix++) {
+		if (lp->items[ix].fd >= 0) {
+			close(lp->items[ix].fd);
+			lp->items[ix].fd = -1;
+			lp->openFds--;
+			wp->openFds--;
+		}
+	}
+	fp->list = NULL;
+}
+
+/*
+ * stat the entries of the top directory in inode order
+ *
+ * Inode tables are laid out by inode number, so on rotating disks this
+ * turns the random seeks of the directory (hash) order into a sweep.  The
+ * results are kept in the list, the callbacks are made in directory order.
+ *
+ * Return:
+ *         0	success
+ *        -1	no memory (the entries are stat'ed in directory order)
+ */
+static int inodeList(dirWalk_t *wp, dirFrame_t *fp)
+{
+	dirList_t *lp = fp->list;
+	int        ix, count = 0;
+
+	if ((lp == NULL) || (lp->count == 0)) return 0;
+	if (lp->count > wp->orderSize) {
+		dirOrder_t *newOrder = (dirOrder_t *) realloc(wp->order, lp->count * sizeof(dirOrder_t));
+		if (newOrder == NULL) return -1;
+		wp->order     = newOrder;
+		wp->orderSize = lp->count;
+	}
+
+	/* entries to be stat'ed, sorted by inode number */
+	for (ix = 0; ix < lp->count; ix++) {
+		dirItem_t *item = &lp->items[ix];
+		if ((item->statDone != 0) || (mustStat(wp, item->type) == FALSE)) continue;
+		wp->order[count].ino = item->ino;
+		wp->order[count].ix  = ix;
+		count++;
+	}
+	qsort(wp->order, count, sizeof(dirOrder_t), compareInode);
+
+	for (ix = 0; ix < count; ix++) {
+		dirItem_t *item = &lp->items[wp->order[ix].ix];
+		dirEntry_t entry;
+
+		entry.name     = &lp->names[item->nameOff];
+		entry.fullpath = entry.name;
+		entry.dirfd    = fp->reader.fd;
+		entry.needs    = wp->statNeeds;
+		entry.follow   = wp->bFollow;
+		entry.statDone = 0;
+		entry.hasBtime = 0;
+		if (dirinfo_EntryStat(&entry) == NULL) continue;	/* tried again when visited */
+		item->sb        = entry.sb;
+		item->statDone  = 1;
+		item->hasBtime  = entry.hasBtime;
+		item->btime     = entry.btime;
+		item->btimeNsec = entry.btimeNsec;
+	}
+	return 0;
+}
+
+/* stat the list items left in directory order, all of them if bAll */
+static void statList(dirWalk_t *wp, dirList_t *lp, int dfd, BOOL bAll)
+{
+	if (lp == NULL) return;
+	statRange(wp, lp, dfd, bAll, 0, lp->count);
+}
+
+/* stat the list items first .. last-1 (statList) */
+static void statRange(dirWalk_t *wp, dirList_t *lp, int dfd, BOOL bAll, int first, int last)
+{
+	int ix;
+
+	for (ix = first; ix < last; ix++) {
+		dirItem_t *item = &lp->items[ix];
+		dirEntry_t entry;
+
+		if ((item->statDone != 0) || ((mustStat(wp, item->type) == FALSE) && (bAll == FALSE))) continue;
+		entry.name     = &lp->names[item->nameOff];
+		entry.fullpath = entry.name;
+		entry.dirfd    = dfd;
+		entry.needs    = wp->statNeeds;
+		entry.follow   = wp->bFollow;
+		entry.statDone = 0;
+		entry.hasBtime = 0;
+		if (dirinfo_EntryStat(&entry) == NULL) continue;	/* tried again when visited */
+		item->sb        = entry.sb;
+		item->statDone  = 1;
+		item->hasBtime  = entry.hasBtime;
+		item->btime     = entry.btime;
+		item->btimeNsec = entry.btimeNsec;
+	}
+}
+
+/*
+ * Stat the list items along with the idle workers (DIRINFO_CHUNKS)
+ *
+ * A list longer than chunkSize is cut in chunks, which this worker and
+ * the idle ones take one at a time until none is left.  The helpers only
+ * fill in the items, the list stays with this worker, which waits for them
+ * before it goes on: the callbacks are made in directory order afterwards.
+ */
+static void chunkList(dirWalk_t *wp, dirList_t *lp, int dfd, BOOL bAll, int chunkSize)
+{
+	dirPool_t    *pool;
+	dirChunks_t   chunks;
+	dirChunks_t **cpp;
+
+	if (lp == NULL) return;
+	if ((wp->worker == NULL) || (chunkSize == 0) || (lp->count <= chunkSize)) {
+		statList(wp, lp, dfd, bAll);
+		return;
+	}
+	pool = wp->worker->pool;
+	memset(&chunks, 0, sizeof(chunks));
+	chunks.list      = lp;
+	chunks.dfd       = dfd;
+	chunks.bAll      = bAll;
+	chunks.chunkSize = chunkSize;
+	chunks.chunkCnt  = (lp->count + chunkSize - 1) / chunkSize;
+
+	/* let the idle workers know */
+	pthread_mutex_lock(&pool->lock);
+	chunks.next  = pool->chunks;
+	pool->chunks = &chunks;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	while (statChunk(wp, pool, &chunks) == 0) ;
+
+	/* none left, wait for the chunks still being stat'ed by the others */
+	pthread_mutex_lock(&pool->lock);
+	for (cpp = &pool->chunks; *cpp != &chunks; cpp = &(*cpp)->next) ;
+	*cpp = chunks.next;
+	while (chunks.busy > 0) {
+		pthread_cond_wait(&pool->cond, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (wp->dbgOutput)
+		wp->dbgOutput(OUT_NOISE, "%d entries stat'ed in %d chunks\n", lp->count, chunks.chunkCnt);
+}
+
+/*
+ * Stat the next chunk of a list, cp NULL - of any list with chunks left
+ *
+ * Return:
+ *         0	a chunk has been stat'ed
+ *        -1	no chunk left
+ */
+static int statChunk(dirWalk_t *wp, dirPool_t *pool, dirChunks_t *cp)
+{
+	int first, last;
+
+	pthread_mutex_lock(&pool->lock);
+	if (cp == NULL) {
+		for (cp = pool->chunks; cp && (cp->nextChunk >= cp->chunkCnt); cp = cp->next) ;
+	}
+	if ((cp == NULL) || (cp->nextChunk >= cp->chunkCnt) || pool->stopped) {
+		pthread_mutex_unlock(&pool->lock);
+		return -1;
+	}
+	first = cp->nextChunk++ * cp->chunkSize;
+	cp->busy++;		/* the list is kept until the chunk is done */
+	pthread_mutex_unlock(&pool->lock);
+
+	last = first + cp->chunkSize;
+	if (last > cp->list->count) last = cp->list->count;
+	statRange(wp, cp->list, cp->dfd, cp->bAll, first, last);
+
+	pthread_mutex_lock(&pool->lock);
+	if (--cp->busy == 0) pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+
+/* any chunk left to be taken (pool->lock held) */
+static BOOL chunksLeft(dirPool_t *pool)
+{
+	dirChunks_t *cp;
+
+	for (cp = pool->chunks; cp; cp = cp->next) {
+		if (cp->nextChunk < cp->chunkCnt) return TRUE;
+	}
+	return FALSE;
+}
+
+/*
+ * Policy of the file system of a directory (DIRINFO_FS_POLICY)
+ *
+ * The type is looked up with fstatfs() only when the directory is on
+ * another device than the last one, i.e. at mount points.
+ *
+ * Return: the policy, NULL for a type not in the table (the defaults)
+ */
+static const dirFsPolicy_t *fsPolicy(dirWalk_t *wp, int dfd, dev_t dev)
+{
+#ifdef	__linux__
+	/* f_type magic numbers, see statfs(2) */
+	static const dirFsPolicy_t policies[] = {
+		/* pseudo file systems */
+		{ 0x9fa0,     "proc",       DIRFS_PSEUDO, 0 },
+		{ 0x62656572, "sysfs",      DIRFS_PSEUDO, 0 },
+		{ 0x1cd1,     "devpts",     DIRFS_PSEUDO, 0 },
+		{ 0x27e0eb,   "cgroup",     DIRFS_PSEUDO, 0 },
+		{ 0x63677270, "cgroup2",    DIRFS_PSEUDO, 0 },
+		{ 0x64626720, "debugfs",    DIRFS_PSEUDO, 0 },
+		{ 0x74726163, "tracefs",    DIRFS_PSEUDO, 0 },
+		{ 0x73636673, "securityfs", DIRFS_PSEUDO, 0 },
+		{ 0xcafe4a11, "bpf",        DIRFS_PSEUDO, 0 },
+		{ 0x6e736673, "nsfs",       DIRFS_PSEUDO, 0 },
+		/* in memory, not worth splitting */
+		{ 0x01021994, "tmpfs",      0, -1 },
+		{ 0x858458f6, "ramfs",      0, -1 },
+		/* local disks, hashed directories (htree) are far from inode order */
+		{ 0xef53,     "ext2/3/4",   DIRFS_INODE_ORDER, 0 },
+		{ 0x58465342, "xfs",        0, 0 },
+		{ 0x9123683e, "btrfs",      0, 0 },
+		/* network, every stat is a round trip: smaller chunks, more of them in flight */
+		{ 0x6969,     "nfs",        0, 256 },
+		{ 0xff534d42, "cifs",       0, 256 },
+		{ 0xfe534d42, "smb2",       0, 256 },
+		{ 0x00c36400, "ceph",       0, 256 },
+		{ 0x65735546, "fuse",       DIRFS_NO_DTYPE, 256 },
+	};
+	struct statfs sfs;
+	int           ix;
+
+	if ((wp->fsDev == dev) && (wp->fsDev != 0)) return wp->fsPolicy;
+	wp->fsDev    = dev;
+	wp->fsPolicy = NULL;
+	if (fstatfs(dfd, &sfs) != 0) return NULL;
+	for (ix = 0; ix < (int) (sizeof(policies) / sizeof(policies[0])); ix++) {
+		if ((unsigned long) (unsigned int) sfs.f_type == policies[ix].type) {
+			wp->fsPolicy = &policies[ix];
+			break;
+		}
+	}
+	if (wp->dbgOutput)
+		wp->dbgOutput(OUT_INFO, "device %#lx: %s file system (%#lx)\n", (unsigned long) dev,
+			wp->fsPolicy ? wp->fsPolicy->name : "other", (unsigned long) sfs.f_type);
+	return wp->fsPolicy;
+#else
+	return NULL;
+#endif	/* __linux__ */
+}
+
+/* entries per chunk under the policy (0 - not split) */
+static int policyChunk(dirWalk_t *wp, const dirFsPolicy_t *pp)
+{
+	if ((wp->chunkSize == 0) || (pp == NULL) || (pp->chunkSize == 0)) return wp->chunkSize;
+	return (pp->chunkSize < 0) ? 0 : pp->chunkSize;
+}
+
+/*
+ * Hand the entries of a directory over to batchProc, as a struct of arrays
+ *
+ * The names stay in the name buffer of the list, where they follow one
+ * another.  The actions set by the callback are kept in the list items
+ * for the visit of every entry after.
+ *
+ * Return: what the callback wants (DIRINFO_CONTINUE, ...)
+ */
+static int batchList(dirWalk_t *wp, dirList_t *lp, const char *dirpath, int dfd, int level)
+{
+	matchCriteria_t *mcbuf = wp->mcbuf;
+	dirBatch_t      *bp = &wp->batch;
+	int              ix, rc;
+
+	if ((lp == NULL) || (lp->count == 0)) return DIRINFO_CONTINUE;
+	if ((lp->count > wp->batchSize) && (growBatch(wp, lp->count) != 0)) {
+		if (wp->dbgOutput)
+			wp->dbgOutput(OUT_WARN, "%s: no memory for the batch, skipped\n", dirpath);
+		return DIRINFO_CONTINUE;
+	}
+
+	for (ix = 0; ix < lp->count; ix++) {
+		dirItem_t *item = &lp->items[ix];
+
+		bp->nameOff[ix] = (unsigned) item->nameOff;
+		bp->nameLen[ix] = (unsigned short) itemNameLen(lp, ix);
+		if (item->statDone == 1) {
+			bp->type[ix]  = (unsigned char) IFTODT(item->sb.st_mode);
+			bp->mode[ix]  = item->sb.st_mode;
+			bp->size[ix]  = item->sb.st_size;
+			bp->mtime[ix] = item->sb.st_mtime;
+		}
+		else {
+			bp->type[ix]  = (unsigned char) item->type;
+			bp->mode[ix]  = (item->type) ? DTTOIF(item->type) : 0;
+			bp->size[ix]  = 0;
+			bp->mtime[ix] = 0;
+		}
+		bp->action[ix] = DIRINFO_CONTINUE;
+	}
+	bp->dirpath = dirpath;
+	bp->dirfd   = dfd;
+	bp->level   = level;
+	bp->count   = lp->count;
+	bp->names   = lp->names;
+
+	/* ***
+	 * call provided function for the whole directory ...
+	 * */
+	if (wp->cbLock) {
+		pthread_mutex_lock(wp->cbLock);
+		if (*wp->stop) {
+			/* stopped by another worker meanwhile */
+			pthread_mutex_unlock(wp->cbLock);
+			return DIRINFO_CONTINUE;
+		}
+	}
+	rc = callbackAction((mcbuf->batchProc) (bp, mcbuf));
+	if (wp->cbLock) pthread_mutex_unlock(wp->cbLock);
+
+	for (ix = 0; ix < lp->count; ix++) {
+		lp->items[ix].action = (rc == DIRINFO_SKIP_SUBTREE) ? DIRINFO_SKIP_SUBTREE : callbackAction(bp->action[ix]);
+	}
+	return rc;
+}
+
+/* make room for count entries in the batch arrays */
+static int growBatch(dirWalk_t *wp, int count)
+{
+	dirBatch_t *bp = &wp->batch;
+	void       *p;
+
+#define	GROW_ARRAY(field)	\
+	if ((p = realloc(bp->field, count * sizeof(*bp->field))) == NULL) return -1;	\
+	bp->field = p
+	GROW_ARRAY(nameOff);
+	GROW_ARRAY(nameLen);
+	GROW_ARRAY(type);
+	GROW_ARRAY(mode);
+	GROW_ARRAY(size);
+	GROW_ARRAY(mtime);
+	GROW_ARRAY(action);
+#undef	GROW_ARRAY
+	wp->batchSize = count;
+	return 0;
+}
+
+/* qsort() comparison of inode numbers */
+static int compareInode(const void *p1, const void *p2)
+{
+	ino_t ino1 = ((const dirOrder_t *) p1)->ino;
+	ino_t ino2 = ((const dirOrder_t *) p2)->ino;
+	return (ino1 < ino2) ? -1 : (ino1 > ino2) ? 1 : 0;
+}
+
+#ifdef	HAVE_IO_URING
+/*
+ * Set up an io_uring instance with <entries> submission slots
+ *
+ * Return:
+ *         the instance
+ *         NULL - io_uring is not available (e.g. disabled or old kernel)
+ */
+static dirUring_t *uringOpen(unsigned entries)
+{
+	struct io_uring_params params;
+	dirUring_t *urp;
+
+	if ((urp = (dirUring_t *) calloc(1, sizeof(dirUring_t))) == NULL) return NULL;
+
+	memset(&params, 0, sizeof(params));
+	if ((urp->fd = (int) syscall(SYS_io_uring_setup, entries, &params)) < 0) {
+		free(urp);
+		return NULL;
+	}
+	urp->entries    = params.sq_entries;
+	urp->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	urp->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	urp->sqesSize   = params.sq_entries * sizeof(struct io_uring_sqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		/* both rings in one mapping */
+		if (urp->cqRingSize > urp->sqRingSize) urp->sqRingSize = urp->cqRingSize;
+		urp->cqRingSize = 0;
+	}
+
+	urp->sqRing = mmap(NULL, urp->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, urp->fd, IORING_OFF_SQ_RING);
+	if (urp->sqRing == MAP_FAILED) {
+		urp->sqRing = NULL;
+		uringClose(urp);
+		return NULL;
+	}
+	if (urp->cqRingSize == 0) {
+		urp->cqRing = urp->sqRing;
+	}
+	else {
+		urp->cqRing = mmap(NULL, urp->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, urp->fd, IORING_OFF_CQ_RING);
+		if (urp->cqRing == MAP_FAILED) {
+			urp->cqRing = NULL;
+			uringClose(urp);
+			return NULL;
+		}
+	}
+	urp->sqes = (struct io_uring_sqe *) mmap(NULL, urp->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, urp->fd, IORING_OFF_SQES);
+	if (urp->sqes == MAP_FAILED) {
+		urp->sqes = NULL;
+		uringClose(urp);
+		return NULL;
+	}
+	if ((urp->stx = (struct statx *) malloc(urp->entries * sizeof(struct statx))) == NULL) {
+		uringClose(urp);
+		return NULL;
+	}
+
+	urp->sqHead  = (unsigned *) ((char *) urp->sqRing + params.sq_off.head);
+	urp->sqTail  = (unsigned *) ((char *) urp->sqRing + params.sq_off.tail);
+	urp->sqMask  = (unsigned *) ((char *) urp->sqRing + params.sq_off.ring_mask);
+	urp->sqArray = (unsigned *) ((char *) urp->sqRing + params.sq_off.array);
+	urp->cqHead  = (unsigned *) ((char *) urp->cqRing + params.cq_off.head);
+	urp->cqTail  = (unsigned *) ((char *) urp->cqRing + params.cq_off.tail);
+	urp->cqMask  = (unsigned *) ((char *) urp->cqRing + params.cq_off.ring_mask);
+	urp->cqes    = (struct io_uring_cqe *) ((char *) urp->cqRing + params.cq_off.cqes);
+	return urp;
+}
+
+/* tear down the io_uring instance */
+static void uringClose(dirUring_t *urp)
+{
+	if (urp->stx) free(urp->stx);
+	if (urp->sqes) munmap(urp->sqes, urp->sqesSize);
+	if (urp->cqRing && (urp->cqRing != urp->sqRing)) munmap(urp->cqRing, urp->cqRingSize);
+	if (urp->sqRing) munmap(urp->sqRing, urp->sqRingSize);
+	close(urp->fd);
+	free(urp);
+}
+
+/* fill in the next submission queue entry */
+static struct io_uring_sqe *uringPrep(dirUring_t *urp, unsigned slot, int opcode, int dfd, const char *name, uint64_t userData)
+{
+	unsigned             tail = *urp->sqTail + slot;
+	unsigned             index = tail & *urp->sqMask;
+	struct io_uring_sqe *sqe = &urp->sqes[index];
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode    = (unsigned char) opcode;
+	sqe->fd        = dfd;
+	sqe->addr      = (uint64_t) (uintptr_t) name;
+	sqe->user_data = userData;
+	urp->sqArray[index] = index;
+	return sqe;
+}
+
+/*
+ * stat (and open the sub-directories of) the entries of the top directory
+ * in batches through io_uring
+ *
+ * Every batch fills the submission queue, and completions are processed as
+ * they arrive.  Entries without a valid result are left to the synchronous
+ * calls.
+ *
+ * Return:
+ *         0	success
+ *        -1	io_uring failed (to be given up)
+ */
+static int uringList(dirWalk_t *wp, dirFrame_t *fp)
+{
+	dirUring_t *urp = wp->uring;
+	dirList_t  *lp = fp->list;
+	BOOL        bOpenDirs = (wp->recursive && (wp->worker == NULL) && (wp->frontMax == 0) &&
+					((wp->maxLevel == 0) || (fp->level < wp->maxLevel))) ? TRUE : FALSE;
+	int         ix = 0;
+
+	while (ix < lp->count)
+	{
+		unsigned submitted = 0, completed = 0, toSubmit;
+
+		/* a batch of requests, user_data = item index << 16 | slot << 1 | openat */
+		for (; (ix < lp->count) && (submitted + 2 <= urp->entries); ix++) {
+			dirItem_t *item = &lp->items[ix];
+			const char *name = &lp->names[item->nameOff];
+
+			if (mustStat(wp, item->type)) {
+				struct io_uring_sqe *sqe = uringPrep(urp, submitted, IORING_OP_STATX, fp->reader.fd, name, ((uint64_t) ix << 16) | (submitted << 1));
+				sqe->len         = statxMask(wp->statNeeds);
+				sqe->off         = (uint64_t) (uintptr_t) &urp->stx[submitted];
+				sqe->statx_flags = wp->bFollow ? 0 : AT_SYMLINK_NOFOLLOW;	/* a dangling link is left to fstatat() */
+				submitted++;
+			}
+			if (bOpenDirs && (item->type == DT_DIR) && (wp->openFds < DIRINFO_URING_MAXFDS) && (wp->openFds < wp->fdFrames / 4)) {
+				struct io_uring_sqe *sqe = uringPrep(urp, submitted, IORING_OP_OPENAT, fp->reader.fd, name, ((uint64_t) ix << 16) | (submitted << 1) | 1);
+				sqe->open_flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+				submitted++;
+				wp->openFds++;		/* reserved, given back if the open fails */
+			}
+		}
+		if (submitted == 0) continue;
+		__atomic_store_n(urp->sqTail, *urp->sqTail + submitted, __ATOMIC_RELEASE);
+
+		/* submit the batch, then reap completions as they arrive */
+		toSubmit = submitted;
+		while (completed < submitted) {
+			int      rc = (int) syscall(SYS_io_uring_enter, urp->fd, toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+			if ((rc < 0) && (errno == EINTR)) continue;
+			if ((rc < 0) || ((rc == 0) && (toSubmit > 0))) {
+				if (wp->dbgOutput)
+					wp->dbgOutput(OUT_WARN, "io_uring_enter failed (errno=%d)\n", errno);
+				uringDrain(wp, lp, submitted - completed);
+				return -1;
+			}
+			toSubmit -= (unsigned) rc;
+			completed += uringReap(wp, lp);
+		}
+	}
+	return 0;
+}
+
+/*
+ * Process the completions arrived so far: the results go to the items
+ *
+ * Return: # of completions
+ */
+static unsigned uringReap(dirWalk_t *wp, dirList_t *lp)
+{
+	dirUring_t *urp = wp->uring;
+	unsigned    head = *urp->cqHead;
+	unsigned    tail = __atomic_load_n(urp->cqTail, __ATOMIC_ACQUIRE);
+	unsigned    count = 0;
+
+	for (; head != tail; head++, count++) {
+		struct io_uring_cqe *cqe = &urp->cqes[head & *urp->cqMask];
+		dirItem_t *item = &lp->items[cqe->user_data >> 16];
+
+		if (cqe->user_data & 1) {
+			/* openat */
+			if (cqe->res >= 0) {
+				item->fd = cqe->res;
+				lp->openFds++;
+			}
+			else {
+				wp->openFds--;
+			}
+		}
+		else {
+			/* statx */
+			if (cqe->res == 0) {
+				const struct statx *stxp = &urp->stx[(cqe->user_data & 0xffff) >> 1];
+				statxToStat(stxp, &item->sb);
+				item->statDone = 1;
+				if (stxp->stx_mask & STATX_BTIME) {
+					item->hasBtime  = 1;
+					item->btime     = (time_t) stxp->stx_btime.tv_sec;
+					item->btimeNsec = (long) stxp->stx_btime.tv_nsec;
+				}
+			}
+		}
+	}
+	__atomic_store_n(urp->cqHead, head, __ATOMIC_RELEASE);
+	return count;
+}
+
+/*
+ * io_uring_enter() failed with pending requests (submitted but not completed
+ * yet): take back the ones the kernel has not consumed, then wait for the
+ * ones in flight, so that no directory is opened behind the caller's back
+ * (the descriptors are kept in the items, wp->openFds stays right)
+ */
+static void uringDrain(dirWalk_t *wp, dirList_t *lp, unsigned pending)
+{
+	dirUring_t *urp = wp->uring;
+	unsigned    head = __atomic_load_n(urp->sqHead, __ATOMIC_ACQUIRE);
+	unsigned    tail = *urp->sqTail;
+
+	/* not consumed, they never will be */
+	while ((tail != head) && (pending > 0)) {
+		struct io_uring_sqe *sqe = &urp->sqes[urp->sqArray[--tail & *urp->sqMask]];
+		if (sqe->user_data & 1) wp->openFds--;	/* the reservation of openat */
+		pending--;
+	}
+	__atomic_store_n(urp->sqTail, tail, __ATOMIC_RELEASE);
+
+	/* in flight */
+	while (pending > 0) {
+		int rc = (int) syscall(SYS_io_uring_enter, urp->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if ((rc < 0) && (errno != EINTR)) {
+			if (wp->dbgOutput)
+				wp->dbgOutput(OUT_WARN, "io_uring: %u requests left in flight (errno=%d)\n", pending, errno);
+			break;
+		}
+		pending -= uringReap(wp, lp);
+	}
+}
+#endif	/* HAVE_IO_URING */
+
+/*
+ * Parallel traversal (dirinfo_FindParallel)
+ *
+ * Every sub-directory found becomes a task.  Each worker owns a deque of
+ * tasks: the owner pushes and pops at the tail (depth first, the directory
+ * cache stays warm) while idle workers steal from the head, which holds the
+ * shallowest, i.e. usually the biggest, sub-trees.
+ * A task lives until all its sub-directories are done, so postFunc is still
+ * called after the whole sub-tree has been visited.
+ */
+static dirTask_t *newTask(const char *path, int delimiter, int level, dirTask_t *parent)
+{
+	size_t     len = strlen(path);
+	dirTask_t *tp = (dirTask_t *) malloc(sizeof(dirTask_t) + len);
+
+	if (tp == NULL) return NULL;
+	tp->parent    = parent;
+	tp->pending   = 1;
+	tp->level     = level;
+	tp->delimiter = delimiter;
+	tp->dfd       = -1;
+	tp->parentDir = NULL;
+	tp->nameOff   = 0;
+	tp->visited   = FALSE;
+	tp->state     = TASK_QUEUED;
+	tp->refs      = 1;
+	tp->cancelled = FALSE;
+	tp->list      = NULL;
+	tp->children  = NULL;
+	tp->ownDir    = NULL;
+	tp->dev       = (parent) ? parent->dev : 0;
+	tp->bSlot     = FALSE;
+	tp->parked    = NULL;
+	memset(&tp->sb, 0, sizeof(tp->sb));
+	tp->pathLen   = len;
+	memcpy(tp->path, path, len + 1);
+	return tp;
+}
+
+/*
+ * Queue the task in the deque of the worker
+ *
+ * Return:
+ *         0	success
+ *        -1	no memory (the task is freed)
+ */
+static int queueTask(dirWorker_t *wkp, dirTask_t *tp)
+{
+	dirPool_t  *pool = wkp->pool;
+	dirDeque_t *dqp = &wkp->deque;
+
+	pthread_mutex_lock(&dqp->lock);
+	if (dqp->count == dqp->size) {
+		/* grow the circular buffer, oldest task first */
+		int         ix, newSize = (dqp->size) ? dqp->size * 2 : 64;
+		dirTask_t **newTasks = (dirTask_t **) malloc(newSize * sizeof(dirTask_t *));
+		if (newTasks == NULL) {
+			pthread_mutex_unlock(&dqp->lock);
+			freeTask(tp);
+			return -1;
+		}
+		for (ix = 0; ix < dqp->count; ix++) {
+			newTasks[ix] = dqp->tasks[(dqp->head + ix) % dqp->size];
+		}
+		if (dqp->tasks) free(dqp->tasks);
+		dqp->tasks = newTasks;
+		dqp->size  = newSize;
+		dqp->head  = 0;
+	}
+
+	/* account the task before anybody can take it */
+	pthread_mutex_lock(&pool->lock);
+	if (tp->parent) tp->parent->pending++;
+	pool->queued++;
+	pool->outstanding++;
+	/* workers put aside by adaptPool() wait as well, one of them would
+	 * take the wakeup of a worker at work and go on waiting
+	 */
+	if (pool->adaptive) pthread_cond_broadcast(&pool->cond);
+	else pthread_cond_signal(&pool->cond);
+	pthread_mutex_unlock(&pool->lock);
+
+	dqp->tasks[(dqp->head + dqp->count) % dqp->size] = tp;
+	dqp->count++;
+	pthread_mutex_unlock(&dqp->lock);
+	return 0;
+}
+
+/*
+ * Next task for the worker: its own newest task or the oldest task of
+ * another worker
+ */
+static dirTask_t *takeTask(dirWorker_t *wkp)
+{
+	dirPool_t *pool = wkp->pool;
+	dirTask_t *tp = NULL;
+	int        ix;
+
+	for (ix = 0; (tp == NULL) && (ix < pool->nworkers); ix++) {
+		dirDeque_t *dqp = &pool->workers[(wkp->id + ix) % pool->nworkers].deque;
+
+		pthread_mutex_lock(&dqp->lock);
+		if (dqp->count > 0) {
+			if (ix == 0) {
+				/* own deque, pop the tail */
+				tp = dqp->tasks[(dqp->head + dqp->count - 1) % dqp->size];
+			}
+			else {
+				/* steal the head */
+				tp = dqp->tasks[dqp->head];
+				dqp->head = (dqp->head + 1) % dqp->size;
+			}
+			dqp->count--;
+		}
+		pthread_mutex_unlock(&dqp->lock);
+	}
+
+	if (tp) {
+		pthread_mutex_lock(&pool->lock);
+		pool->queued--;
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return tp;
+}
+
+/*
+ * Open the directory of the task, relative to its parent unless it is the
+ * top one (the reference to the parent is released)
+ *
+ * Return: the descriptor, -1 on error
+ */
+static int openTask(dirWalk_t *wp, dirTask_t *tp)
+{
+	int dfd = tp->dfd;
+
+	tp->dfd = -1;
+	if (dfd < 0) {
+		/* it could have been removed meanwhile */
+		if (tp->parentDir) dfd = openat(tp->parentDir->fd, &tp->path[tp->nameOff], wp->dirOpenFlags);
+		else dfd = open(tp->path, wp->dirOpenFlags);
+	}
+	putHandle(tp->parentDir);
+	tp->parentDir = NULL;
+	if (dfd < 0) {
+		if ((errno == EMFILE) || (errno == ENFILE) || (errno == ENOMEM))
+			walkError(wp, tp->path, "error opening directory", errno);	/* out of descriptors */
+		else if (wp->dbgOutput)
+			wp->dbgOutput(OUT_WARN, "%s: error opening directory\n", tp->path);
+	}
+	return dfd;
+}
+
+/* free the task, it is not opened any more */
+static void freeTask(dirTask_t *tp)
+{
+	if (tp->dfd >= 0) close(tp->dfd);
+	putHandle(tp->parentDir);
+	free(tp);
+}
+
+/* traverse the directory of the task (sub-directories are queued) */
+static void runTask(dirWorker_t *wkp, dirTask_t *tp)
+{
+	int dfd;
+	int count;
+
+	if ((dfd = openTask(&wkp->walk, tp)) < 0) return;
+
+	wkp->task = tp;
+	count = findAt(&wkp->walk, dfd, tp->path, tp->delimiter, tp->level);
+	if (count >= 0) {
+		tp->visited = TRUE;
+		wkp->count += count;
+	}
+	wkp->task = NULL;
+}
+
+/*
+ * The task has been run: complete it and every ancestor whose sub-directories
+ * are all done
+ */
+static void finishTask(dirWorker_t *wkp, dirTask_t *tp)
+{
+	dirPool_t       *pool = wkp->pool;
+	matchCriteria_t *mcbuf = wkp->walk.mcbuf;
+	int              pending;
+
+	while (tp) {
+		dirTask_t *parent = tp->parent;
+
+		pthread_mutex_lock(&pool->lock);
+		pending = --tp->pending;
+		pthread_mutex_unlock(&pool->lock);
+		if (pending > 0) break;
+
+		/* ***
+		 * call provided callback function for this directory
+		 * */
+		if (tp->visited && mcbuf && mcbuf->postFunc && (pool->stopped == 0)) {
+			int rc;
+			if (wkp->walk.cbLock) pthread_mutex_lock(wkp->walk.cbLock);
+			if (pool->stopped == 0) {
+				rc = (mcbuf->postFunc) (tp->path, tp->path, &tp->sb, mcbuf);
+				if (callbackAction(rc) == DIRINFO_STOP) pool->stopped = STOP_CALLBACK;
+			}
+			if (wkp->walk.cbLock) pthread_mutex_unlock(wkp->walk.cbLock);
+		}
+		freeTask(tp);
+		tp = parent;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	if (--pool->outstanding == 0) {
+		/* all done, wake up idle workers to let them go */
+		pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/* worker thread */
+static void *workerMain(void *arg)
+{
+	dirWorker_t *wkp = (dirWorker_t *) arg;
+	dirPool_t   *pool = wkp->pool;
+	dirTask_t   *tp;
+	BOOL         bDone = FALSE;
+
+	if (pool->ordered) {
+		readAheadMain(wkp);
+		return NULL;
+	}
+
+	while (bDone == FALSE) {
+		/* put aside by adaptPool(), straight to the wait */
+		BOOL bAside = (wkp->id >= __atomic_load_n(&pool->active, __ATOMIC_RELAXED)) ? TRUE : FALSE;
+
+		if ((bAside == FALSE) && ((tp = takeTask(wkp)) != NULL)) {
+			/* the device has enough workers, the task waits for one of them */
+			if (deviceEnter(pool, tp) == FALSE) continue;
+			while (tp) {
+				dirTask_t *next;
+
+				/* once stopped, the tasks left are only retired */
+				if (pool->stopped == 0) runTask(wkp, tp);
+				next = deviceLeave(pool, tp);	/* next one waiting for the device */
+				finishTask(wkp, tp);
+				tp = next;
+			}
+			if (pool->adaptive) adaptPool(wkp);
+			continue;
+		}
+
+		/* nothing to take, help stat a big directory */
+		if ((bAside == FALSE) && (statChunk(&wkp->walk, pool, NULL) == 0)) continue;
+
+		/* wait for new tasks or the end of traversal, or to be put back to work */
+		pthread_mutex_lock(&pool->lock);
+		while ((pool->outstanding > 0) &&
+		       ((wkp->id >= pool->active) || ((pool->queued == 0) && (chunksLeft(pool) == FALSE)))) {
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		}
+		bDone = (pool->outstanding == 0) ? TRUE : FALSE;
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return NULL;
+}
+
+/* worker reading directories ahead of the sequencer (DIRINFO_ORDERED) */
+static void readAheadMain(dirWorker_t *wkp)
+{
+	dirPool_t *pool = wkp->pool;
+	dirTask_t *tp;
+	BOOL       bClaimed;
+	BOOL       bTake;			/* room to read ahead */
+
+	for (;;) {
+		/* wait for tasks, and for the sequencer to catch up when far enough ahead
+		 * (or to be put back to work, DIRINFO_ADAPTIVE)
+		 */
+		pthread_mutex_lock(&pool->lock);
+		while ((pool->done == FALSE) &&
+		       ((wkp->id >= pool->active) ||
+		        (((pool->queued == 0) || aheadFull(pool)) && (chunksLeft(pool) == FALSE)))) {
+			pthread_cond_wait(&pool->cond, &pool->lock);
+		}
+		if (pool->done) {
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		bTake = ((pool->queued > 0) && (aheadFull(pool) == FALSE)) ? TRUE : FALSE;
+		pthread_mutex_unlock(&pool->lock);
+
+		/* a big directory being stat'ed first, the sequencer may be waiting for it */
+		if (statChunk(&wkp->walk, pool, NULL) == 0) continue;
+		if ((bTake == FALSE) || ((tp = takeTask(wkp)) == NULL)) continue;
+
+		/* the device has enough workers, the task waits for one of them
+		 * (the sequencer reads it itself if it gets there first)
+		 */
+		if (deviceEnter(pool, tp) == FALSE) continue;
+		while (tp) {
+			dirTask_t *next;
+
+			/* the sequencer may have read it already, or not want it any more */
+			pthread_mutex_lock(&pool->lock);
+			bClaimed = ((tp->state == TASK_QUEUED) && (tp->cancelled == FALSE) && (pool->stopped == 0)) ? TRUE : FALSE;
+			if (bClaimed) {
+				tp->state = TASK_READING;
+				tp->ahead = TRUE;
+				pool->ahead++;
+			}
+			pthread_mutex_unlock(&pool->lock);
+
+			if (bClaimed) readAhead(wkp, tp);
+
+			next = deviceLeave(pool, tp);
+			pthread_mutex_lock(&pool->lock);
+			if (bClaimed) {
+				tp->state = TASK_READ;
+				pool->buffered += listBytes(tp);
+				if (tp->cancelled) {
+					/* pruned meanwhile */
+					cancelChildren(pool, tp);
+					freeList(pool, tp);
+				}
+				pthread_cond_broadcast(&pool->cond);
+			}
+			if (--tp->refs == 0) destroyTask(pool, tp);
+			pthread_mutex_unlock(&pool->lock);
+			tp = next;
+		}
+		if (pool->adaptive) adaptPool(wkp);
+	}
+}
+
+/*
+ * Read the entries of the task directory into its list and stat them,
+ * then queue its sub-directories to be read ahead as well
+ *
+ * tp->list stays NULL if the directory cannot be read, or if it is one of
+ * its own ancestors (DIRINFO_FOLLOW).
+ */
+static void readAhead(dirWorker_t *wkp, dirTask_t *tp)
+{
+	dirWalk_t  *wp = &wkp->walk;
+	dirFrame_t  frame;
+	dirList_t  *lp;
+	dirTask_t  *ap;
+	const dirFsPolicy_t *pp = NULL;
+	dirHandle_t *hp;
+	size_t      offset = tp->pathLen + (tp->delimiter ? 1 : 0);
+	int         dfd;
+	int         nx;
+	char       *buf;
+	size_t      bufSize;
+	BOOL        bLong = ((offset + NAME_MAX) >= PATH_MAX) ? TRUE : FALSE;
+	BOOL        bKeep = FALSE;	/* the sequencer may find sub-directories itself */
+
+	if ((dfd = openTask(wp, tp)) < 0) return;
+	if (fstat(dfd, &tp->sb) != 0) memset(&tp->sb, 0, sizeof(tp->sb));
+
+	/* how to go about its file system, pseudo ones are only read on purpose */
+	if (wp->bFsPolicy && (tp->sb.st_ino != 0) && ((pp = fsPolicy(wp, dfd, tp->sb.st_dev)) != NULL) &&
+		(pp->flags & DIRFS_PSEUDO) && (tp->level > wp->baseLevel)) {
+		if (wp->dbgOutput)
+			wp->dbgOutput(OUT_INFO, "%s: %s file system, skipped\n", tp->path, pp->name);
+		close(dfd);
+		return;
+	}
+
+	/* following symbolic links, do not go round in circles */
+	for (ap = tp->parent; wp->bFollow && ap; ap = ap->parent) {
+		if ((ap->sb.st_dev == tp->sb.st_dev) && (ap->sb.st_ino == tp->sb.st_ino)) {
+			close(dfd);
+			return;
+		}
+	}
+
+	memset(&frame, 0, sizeof(frame));
+	frame.level = tp->level;
+	buf = direntBuffer(wp, 0, &bufSize);
+	if (openReader(&frame.reader, dfd, buf, bufSize) != 0) {
+		walkError(wp, tp->path, "error opening directory", errno);
+		close(dfd);
+		return;
+	}
+	if (pp && (pp->flags & DIRFS_NO_DTYPE)) frame.reader.bNoType = TRUE;
+	if (readList(wp, &frame, 0) != 0) {
+		walkError(wp, tp->path, "no memory, entries left out", ENOMEM);
+	}
+	if (frame.reader.error) walkError(wp, tp->path, "error reading directory", frame.reader.error);
+	if ((lp = frame.list) == NULL) {
+		closeReader(&frame.reader);
+		return;
+	}
+
+#ifdef	HAVE_IO_URING
+	if (wp->bUring) {
+		if ((wp->uring == NULL) && ((wp->uring = uringOpen(DIRINFO_URING_ENTRIES)) == NULL)) {
+			wp->bUring = FALSE;
+		}
+		else if (uringList(wp, &frame) != 0) {
+			uringClose(wp->uring);
+			wp->uring  = NULL;
+			wp->bUring = FALSE;
+		}
+	}
+#endif	/* HAVE_IO_URING */
+	if ((wp->bInodeOrder || (pp && (pp->flags & DIRFS_INODE_ORDER))) && (wp->bUring == FALSE)) inodeList(wp, &frame);
+
+	/* the entries left are stat'ed in directory order, all of them under a
+	 * pathname too long to be stat'ed by the sequencer on demand
+	 */
+	chunkList(wp, lp, frame.reader.fd, bLong, policyChunk(wp, pp));
+	closeList(wp, &frame);
+	wp->lists[0] = NULL;		/* the list goes with the task */
+	tp->list     = lp;
+
+	/* sub-directories, to be popped in directory order by this worker
+	 * (the deque of the sequencer is only stolen from, oldest first) and
+	 * opened relative to this one, by pathname beyond wp->handleMax
+	 */
+	if ((wp->recursive == 0) || ((wp->maxLevel != 0) && (tp->level >= wp->maxLevel)) || (lp->count == 0)) {
+		closeReader(&frame.reader);
+		return;
+	}
+	hp = frameHandle(wp, &frame);
+	if ((tp->children = (dirTask_t **) calloc(lp->count, sizeof(dirTask_t *))) == NULL) bKeep = TRUE;
+	for (nx = 0; (tp->children != NULL) && (nx < lp->count); nx++) {
+		dirItem_t *item;
+		dirTask_t *child;
+		size_t     nameLen;
+		int        ix = (wkp->id == 0) ? nx : lp->count - 1 - nx;
+
+		item = &lp->items[ix];
+		if ((item->statDone == 1) ? !S_ISDIR(item->sb.st_mode) : (item->type != DT_DIR)) {
+			/* a symbolic link or an unknown type could still be one */
+			if ((item->statDone != 1) && ((item->type == DT_LNK) || (item->type == DT_UNKNOWN))) bKeep = TRUE;
+			continue;
+		}
+		if (wp->bOneFs && (item->statDone == 1) && (item->sb.st_dev != wp->rootDev)) continue;
+
+		nameLen = itemNameLen(lp, ix);
+		if (growPath(wp, offset + nameLen) != 0) {
+			bKeep = TRUE;
+			continue;
+		}
+		memcpy(wp->path, tp->path, offset);
+		if (tp->delimiter) wp->path[offset - 1] = (char) tp->delimiter;
+		memcpy(&wp->path[offset], &lp->names[item->nameOff], nameLen + 1);
+		if ((child = childTask(wkp->pool, tp, wp->path, 2)) == NULL) {	/* the deque & the parent */
+			bKeep = TRUE;
+			continue;
+		}
+		if (item->statDone == 1) child->dev = item->sb.st_dev;
+		if (hp) {
+			child->parentDir = holdHandle(hp);
+			child->nameOff   = offset;
+		}
+		else if (offset + nameLen >= PATH_MAX) {
+			/* out of handles and too long to be opened by name, open it now */
+			child->dfd = openat(frame.reader.fd, &lp->names[item->nameOff], wp->dirOpenFlags);
+		}
+		if (queueTask(wkp, child) == 0) {
+			tp->children[item - lp->items] = child;
+		}
+		else {
+			/* no memory, the sequencer will read it (queueTask freed it) */
+			pthread_mutex_lock(&wkp->pool->lock);
+			tp->refs--;
+			pthread_mutex_unlock(&wkp->pool->lock);
+			bKeep = TRUE;
+		}
+	}
+
+	/* kept for the ones the sequencer finds itself, until it is done with the list */
+	if (bKeep) tp->ownDir = holdHandle(hp);
+	putHandle(frame.handle);
+	closeReader(&frame.reader);
+}
+
+/*
+ * The sequencer is about to visit the directory of the task: read it
+ * unless a worker is reading or has read it already
+ *
+ * Return:
+ *         0	success, the entries are in tp->list
+ *        -1	the directory cannot be read or has been visited already
+ */
+static int enterTask(dirWorker_t *wkp, dirTask_t *tp)
+{
+	dirPool_t *pool = wkp->pool;
+	dirWalk_t *wp = &wkp->walk;
+	BOOL       bClaimed = FALSE;
+
+	pthread_mutex_lock(&pool->lock);
+	if (tp->state == TASK_QUEUED) {
+		tp->state = TASK_READING;
+		bClaimed  = TRUE;
+	}
+	while ((bClaimed == FALSE) && (tp->state != TASK_READ)) {
+		pthread_cond_wait(&pool->cond, &pool->lock);
+	}
+	if (tp->ahead) {
+		/* reached, room to read another one ahead */
+		tp->ahead = FALSE;
+		pool->ahead--;
+		pthread_cond_broadcast(&pool->cond);
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (bClaimed) {
+		readAhead(wkp, tp);
+		pthread_mutex_lock(&pool->lock);
+		tp->state = TASK_READ;
+		pool->buffered += listBytes(tp);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	/* following symbolic links, every directory is visited once */
+	if (wp->visited && (tp->sb.st_ino != 0) && (visitedAdd(wp->visited, tp->sb.st_dev, tp->sb.st_ino) == 0)) {
+		if (wp->dbgOutput)
+			wp->dbgOutput(OUT_INFO, "%s: visited already, skipped\n", tp->path);
+		return -1;
+	}
+	if (tp->list == NULL) return -1;
+
+	/* debug */
+	if (wp->dbgOutput)
+		wp->dbgOutput(OUT_INFO, "Entering [%s] (read ahead)\n", tp->path);
+
+	/* the entries were stat'ed ahead, the directory is not open any more */
+	if (wp->bBatch && (batchList(wp, tp->list, tp->path, -1, tp->level) == DIRINFO_STOP)) {
+		pool->stopped = STOP_CALLBACK;
+	}
+	return 0;
+}
+
+/*
+ * Make the callbacks for the tree read ahead, in the order of dirinfo_Find()
+ * (DIRINFO_ORDERED)
+ *
+ * The directory being visited is the current task, its parents up to the
+ * top directory are the ones being visited as well, and the next entry of
+ * each is kept in its list.  A task is released once visited or pruned.
+ *
+ * Return: # of entries in the top directory, -1 if it cannot be read
+ */
+static int sequenceTasks(dirWorker_t *wkp, dirTask_t *root)
+{
+	dirPool_t       *pool = wkp->pool;
+	dirWalk_t       *wp = &wkp->walk;
+	matchCriteria_t *mcbuf = wp->mcbuf;
+	dirInfo_t       *dip = wp->dip;
+	OutputFunc      dbgOutput = wp->dbgOutput;
+	dirTask_t       *tp = root;		/* directory being visited */
+	dirTask_t       *child;			/* sub-directory of current entry */
+	dirList_t       *lp;
+	dirItem_t       *item;
+	dirEntry_t       entry;
+	struct stat      sb;
+	struct stat     *statp;
+	const char      *direntName;
+	size_t           offset, nameLen;
+	int              ix, action;
+	int              count = -1;
+
+	if (enterTask(wkp, root) != 0) {
+		pthread_mutex_lock(&pool->lock);
+		releaseTask(pool, root);
+		pthread_mutex_unlock(&pool->lock);
+		return -1;
+	}
+
+	while (tp && (pool->stopped == 0))
+	{
+		lp = tp->list;
+		if (lp->next >= lp->count) {
+			/* end of directory, back to the parent */
+			dirTask_t *parent = tp->parent;
+
+			if (tp == root) count = lp->count;
+			if (dbgOutput) {
+				dbgOutput(OUT_NOISE, "dirent count=%d\n", lp->count);
+				dbgOutput(OUT_INFO, "Leaving [%s]\n", tp->path);
+			}
+			if (mcbuf->postFunc) {
+				int rc = (mcbuf->postFunc) (tp->path, tp->path, &tp->sb, mcbuf);
+				if (callbackAction(rc) == DIRINFO_STOP) pool->stopped = STOP_CALLBACK;
+			}
+			pthread_mutex_lock(&pool->lock);
+			releaseTask(pool, tp);
+			pthread_cond_broadcast(&pool->cond);	/* room to read ahead */
+			pthread_mutex_unlock(&pool->lock);
+			tp = parent;
+			continue;
+		}
+
+		/* cancelled or timed out, the workers wind down as well */
+		if ((action = mustEnd(mcbuf, &wp->ticks)) != 0) {
+			pool->stopped = action;
+			break;
+		}
+		ix   = lp->next++;
+		item = &lp->items[ix];
+		if (pool->adaptive) adaptCount(wkp);
+		direntName = &lp->names[item->nameOff];
+
+		/* the sub-directory read ahead, if any, is taken over */
+		child = NULL;
+		if (tp->children) {
+			child = tp->children[ix];
+			tp->children[ix] = NULL;
+		}
+
+		/* full pathname */
+		nameLen = itemNameLen(lp, ix);
+		offset  = tp->pathLen + (tp->delimiter ? 1 : 0);
+		if (growPath(wp, offset + nameLen) != 0) {
+			if (dbgOutput)
+				dbgOutput(OUT_WARN, "%s: no memory for the pathname, skipped\n", direntName);
+			dropTask(pool, child);
+			continue;
+		}
+		memcpy(wp->path, tp->path, offset);
+		if (tp->delimiter) wp->path[offset - 1] = (char) tp->delimiter;
+		memcpy(&wp->path[offset], direntName, nameLen + 1);
+
+		/* entry handle, stat'ed ahead (the directory is not open any more) */
+		entry.name     = direntName;
+		entry.fullpath = wp->path;
+		entry.nameLen  = (int) nameLen;
+		entry.pathLen  = (int) (offset + nameLen);
+		entry.type     = item->type;
+		entry.dirfd    = -1;
+		entry.needs    = wp->statNeeds;
+		entry.follow   = wp->bFollow;
+		entry.statDone = 0;
+		entry.hasBtime = 0;
+		if (item->statDone == 1) {
+			entry.sb        = item->sb;
+			entry.statDone  = 1;
+			entry.hasBtime  = item->hasBtime;
+			entry.btime     = item->btime;
+			entry.btimeNsec = item->btimeNsec;
+		}
+		statp = &sb;
+		if (mustStat(wp, item->type) || (typeStat(item->type, item->ino, &sb) != 0)) {
+			if ((statp = dirinfo_EntryStat(&entry)) == NULL) {
+				if (dbgOutput)
+					dbgOutput(OUT_WARN, "%s: fstatat failed (errno=%d)\n", wp->path, errno);
+				dropTask(pool, child);
+				continue;
+			}
+		}
+
+		/* ***
+		 * call provided function ...
+		 * */
+		action = DIRINFO_CONTINUE;
+		if (mcbuf->proc) {
+			action = callbackAction((mcbuf->proc) (direntName, wp->path, statp, mcbuf));
+		}
+		if (mcbuf->entryProc && (action != DIRINFO_STOP)) {
+			int rc = callbackAction((mcbuf->entryProc) (&entry, mcbuf));
+			if (rc != DIRINFO_CONTINUE) action = rc;
+		}
+		if (action == DIRINFO_STOP) pool->stopped = STOP_CALLBACK;
+		if ((item->action == DIRINFO_SKIP_SUBTREE) && (action == DIRINFO_CONTINUE)) {
+			action = DIRINFO_SKIP_SUBTREE;		/* pruned by batchProc */
+		}
+
+		/* brief file information */
+		if (dbgOutput)
+			dbgOutput(OUT_INFO, "  %s [%s]\n", wp->path, modeString(statp->st_mode));
+
+		/* statistics */
+		if (dip) {
+			countEntry(dip, statp, tp->level - wp->baseLevel, wp->bSizes);
+		}
+
+		/* mount point, another file system (DIRINFO_ONE_FS) */
+		if (wp->recursive && wp->bOneFs && S_ISDIR(statp->st_mode) && (statp->st_dev != wp->rootDev) && (action == DIRINFO_CONTINUE)) {
+			if (dbgOutput)
+				dbgOutput(OUT_INFO, "%s: mount point, skipped\n", wp->path);
+			action = DIRINFO_SKIP_SUBTREE;
+		}
+
+		/* recursive ... (unless pruned or stopped by the callback) */
+		if (wp->recursive && S_ISDIR(statp->st_mode) && (action == DIRINFO_CONTINUE) &&
+			((wp->maxLevel == 0) || (tp->level < wp->maxLevel)))
+		{
+			/* not read ahead (e.g. not a directory by d_type), read it now */
+			if (child == NULL) {
+				if ((child = childTask(pool, tp, wp->path, 1)) == NULL) {
+					if (dbgOutput)
+						dbgOutput(OUT_WARN, "%s: no memory, skipped\n", wp->path);
+					continue;
+				}
+				child->parentDir = holdHandle(tp->ownDir);	/* by pathname if none */
+				child->nameOff   = offset;
+			}
+			if (enterTask(wkp, child) == 0) {
+				tp = child;			/* depth first */
+				continue;
+			}
+		}
+		dropTask(pool, child);
+	}
+
+	/* stopped, release the directories left (postFunc is not called) */
+	while (tp) {
+		dirTask_t *parent = tp->parent;
+		if (tp == root) count = tp->list->next;
+		dropTask(pool, tp);
+		tp = parent;
+	}
+
+	return count;	/* # of entries found */
+}
+
+/* sub-directory of the task, holding a reference to it */
+static dirTask_t *childTask(dirPool_t *pool, dirTask_t *tp, const char *path, int refs)
+{
+	dirTask_t *child = newTask(path, '/', tp->level + 1, tp);
+
+	if (child == NULL) return NULL;
+	child->refs = refs;
+	pthread_mutex_lock(&pool->lock);
+	tp->refs++;
+	pthread_mutex_unlock(&pool->lock);
+	return child;
+}
+
+/* release the task (if any) */
+static void dropTask(dirPool_t *pool, dirTask_t *tp)
+{
+	if (tp == NULL) return;
+	pthread_mutex_lock(&pool->lock);
+	releaseTask(pool, tp);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * The task is not wanted any more, nor its sub-directories (pool->lock held)
+ *
+ * Tasks are referenced by the deque they are queued in (or the worker that
+ * took them), by the parent and by each of their own sub-directory tasks.
+ */
+static void releaseTask(dirPool_t *pool, dirTask_t *tp)
+{
+	tp->cancelled = TRUE;
+	if (tp->ahead) {
+		/* not to be entered */
+		tp->ahead = FALSE;
+		pool->ahead--;
+	}
+	if (tp->state != TASK_READING) {
+		/* no need to wait for the deque (the reader does it otherwise) */
+		cancelChildren(pool, tp);
+		freeList(pool, tp);
+	}
+	if (--tp->refs == 0) destroyTask(pool, tp);
+}
+
+/* release the sub-directories read ahead (pool->lock held) */
+static void cancelChildren(dirPool_t *pool, dirTask_t *tp)
+{
+	int ix;
+
+	if (tp->children == NULL) return;
+	for (ix = 0; ix < tp->list->count; ix++) {
+		if (tp->children[ix] == NULL) continue;
+		releaseTask(pool, tp->children[ix]);
+		tp->children[ix] = NULL;
+	}
+}
+
+/* far enough ahead of the sequencer, by directories or by memory (pool->lock held) */
+static BOOL aheadFull(dirPool_t *pool)
+{
+	if (pool->buffered > pool->bufferMax) return TRUE;
+	return ((pool->aheadMax > 0) && (pool->ahead >= pool->aheadMax)) ? TRUE : FALSE;
+}
+
+/* memory taken by the entries read ahead for the task */
+static size_t listBytes(const dirTask_t *tp)
+{
+	const dirList_t *lp = tp->list;
+
+	if (lp == NULL) return 0;
+	return sizeof(dirList_t) + lp->namesSize + (size_t) lp->size * sizeof(dirItem_t) +
+		((tp->children) ? (size_t) lp->count * sizeof(dirTask_t *) : 0);
+}
+
+/* free the entries read ahead (pool->lock held) */
+static void freeList(dirPool_t *pool, dirTask_t *tp)
+{
+	dirList_t *lp = tp->list;
+
+	if (lp) pool->buffered -= listBytes(tp);
+	if (tp->children) free(tp->children);
+	tp->children = NULL;
+	putHandle(tp->ownDir);
+	tp->ownDir   = NULL;
+	if (lp) {
+		if (lp->names) free(lp->names);
+		if (lp->items) free(lp->items);
+		free(lp);
+	}
+	tp->list = NULL;
+}
+
+/* free the task, then the parents nobody refers to any more (pool->lock held) */
+static void destroyTask(dirPool_t *pool, dirTask_t *tp)
+{
+	while (tp) {
+		dirTask_t *parent = tp->parent;
+
+		freeList(pool, tp);
+		freeTask(tp);
+		tp = (parent && (--parent->refs == 0)) ? parent : NULL;
+	}
+}
+
+/*
+ * Take a worker slot of the device of the task (matchCriteria_t.deviceMax)
+ *
+ * Return:
+ *         TRUE	the task may be run
+ *         FALSE	the device has enough workers, the task waits in its queue
+ *         	until one of them is done (deviceLeave)
+ */
+static BOOL deviceEnter(dirPool_t *pool, dirTask_t *tp)
+{
+	dirDevice_t *devp = NULL;
+	int          ix;
+
+	if (pool->deviceMax == 0) return TRUE;
+	pthread_mutex_lock(&pool->lock);
+	for (ix = 0; ix < pool->deviceCnt; ix++) {
+		if (pool->devices[ix].dev == tp->dev) {
+			devp = &pool->devices[ix];
+			break;
+		}
+	}
+	if (devp == NULL) {
+		if (pool->deviceCnt == pool->deviceSize) {
+			int          newSize = (pool->deviceSize) ? pool->deviceSize * 2 : 8;
+			dirDevice_t *newDevices = (dirDevice_t *) realloc(pool->devices, newSize * sizeof(dirDevice_t));
+			if (newDevices == NULL) {
+				/* no memory, not limited */
+				pthread_mutex_unlock(&pool->lock);
+				return TRUE;
+			}
+			pool->devices    = newDevices;
+			pool->deviceSize = newSize;
+		}
+		devp = &pool->devices[pool->deviceCnt++];
+		memset(devp, 0, sizeof(dirDevice_t));
+		devp->dev = tp->dev;
+	}
+	if (devp->running >= pool->deviceMax) {
+		/* park it */
+		tp->parked = NULL;
+		if (devp->parkTail) devp->parkTail->parked = tp;
+		else devp->parkHead = tp;
+		devp->parkTail = tp;
+		pthread_mutex_unlock(&pool->lock);
+		return FALSE;
+	}
+	devp->running++;
+	tp->bSlot = TRUE;
+	pthread_mutex_unlock(&pool->lock);
+	return TRUE;
+}
+
+/*
+ * The task is done with its device: hand the slot over to the next task
+ * waiting for the device, if any
+ *
+ * Return: the task to be run next by this worker (NULL - none)
+ */
+static dirTask_t *deviceLeave(dirPool_t *pool, dirTask_t *tp)
+{
+	dirTask_t *next = NULL;
+	int        ix;
+
+	if (tp->bSlot == FALSE) return NULL;
+	pthread_mutex_lock(&pool->lock);
+	for (ix = 0; ix < pool->deviceCnt; ix++) {
+		dirDevice_t *devp = &pool->devices[ix];
+		if (devp->dev != tp->dev) continue;
+		if ((next = devp->parkHead) != NULL) {
+			devp->parkHead = next->parked;
+			if (devp->parkHead == NULL) devp->parkTail = NULL;
+			next->parked = NULL;
+			next->bSlot  = TRUE;
+		}
+		else devp->running--;
+		break;
+	}
+	tp->bSlot = FALSE;
+	pthread_mutex_unlock(&pool->lock);
+	return next;
+}
+
+/* an entry visited by the worker, the pool is tuned every so often (DIRINFO_ADAPTIVE) */
+static void adaptCount(dirWorker_t *wkp)
+{
+	unsigned long entries = wkp->entries + 1;
+
+	__atomic_store_n(&wkp->entries, entries, __ATOMIC_RELAXED);
+	if (entries % DIRINFO_ADAPT_TICKS == 0) adaptPool(wkp);
+}
+
+/*
+ * Hill climbing on the entries visited per second (DIRINFO_ADAPTIVE)
+ *
+ * Once every DIRINFO_ADAPT_MSEC the workers at work are moved one step
+ * (a quarter of them, at least one) the same way as the last time, or back
+ * the other way if fewer entries were visited than before.  The worker time
+ * per entry is logged as well, it grows with the latency of the system calls.
+ * Nothing is done while another worker holds the pool lock.
+ */
+static void adaptPool(dirWorker_t *wkp)
+{
+	dirPool_t     *pool = wkp->pool;
+	long long      now = monoMsec();
+	long long      elapsed;
+	unsigned long  entries = 0;
+	double         rate = 0, usec = 0;
+	int            ix, from, active;
+
+	if (pthread_mutex_trylock(&pool->lock) != 0) return;
+	if ((elapsed = now - pool->sampleAt) < DIRINFO_ADAPT_MSEC) {
+		pthread_mutex_unlock(&pool->lock);
+		return;
+	}
+	for (ix = 0; ix < pool->nworkers; ix++) {
+		entries += __atomic_load_n(&pool->workers[ix].entries, __ATOMIC_RELAXED);
+	}
+	from = active = pool->active;
+	if (entries > pool->sampleEntries) {
+		rate = (double) (entries - pool->sampleEntries) * 1000.0 / (double) elapsed;
+		usec = (double) from * (double) elapsed * 1000.0 / (double) (entries - pool->sampleEntries);
+		if (rate < pool->lastRate * 0.95) pool->step = -pool->step;		/* worse, turn around */
+		active += pool->step * ((from > 4) ? from / 4 : 1);
+		if (active < 1) {
+			active = 1;
+			pool->step = 1;
+		}
+		else if (active > pool->nworkers) {
+			active = pool->nworkers;
+			pool->step = -1;
+		}
+		pool->lastRate = rate;
+		if (active != from) {
+			__atomic_store_n(&pool->active, active, __ATOMIC_RELAXED);
+			if (active > from) pthread_cond_broadcast(&pool->cond);	/* back to work */
+		}
+	}
+	pool->sampleAt      = now;
+	pool->sampleEntries = entries;
+	pthread_mutex_unlock(&pool->lock);
+
+	if ((rate > 0) && wkp->walk.dbgOutput) {
+		wkp->walk.dbgOutput(OUT_INFO, "%d workers: %.0f entries/s, %.1f usec per entry, %d next\n", from, rate, usec, active);
+	}
+}
+
+/* monotonic clock in milliseconds */
+static long long monoMsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* stat fields needed for every entry (DIRINFO_NEED_xxx)
+ *
+ * Without a FILEPROC or BATCHPROC callback only the type is needed (statistics & recursion),
+ * ENTRYPROC callbacks stat on demand unless they ask for DIRINFO_PRESTAT
+ * (or DIRINFO_INODE_ORDER).  DIRINFO_SIZES adds the size for the statistics.
+ */
+static int neededFields(matchCriteria_t *mcbuf)
+{
+	int needs;
+
+	if (mcbuf == NULL) return DIRINFO_NEED_TYPE;
+	if ((mcbuf->proc == NULL) && (mcbuf->batchProc == NULL) && ((mcbuf->flags & (DIRINFO_PRESTAT | DIRINFO_INODE_ORDER)) == 0)) needs = DIRINFO_NEED_TYPE;
+	else needs = (mcbuf->needs) ? mcbuf->needs : DIRINFO_NEED_ALL;
+	if (mcbuf->flags & DIRINFO_SIZES) needs |= DIRINFO_NEED_SIZE;
+	return needs;
+}
+
+/* stat fields of entry handles (0 = all), the size as well for DIRINFO_SIZES */
+static int statNeeds(matchCriteria_t *mcbuf)
+{
+	if ((mcbuf->needs != 0) && (mcbuf->flags & DIRINFO_SIZES)) return mcbuf->needs | DIRINFO_NEED_SIZE;
+	return mcbuf->needs;
+}
+
+/*
+ * Fill in the entry type (and inode number) from the directory entry
+ *
+ * Return:
+ *         0	sbp->st_mode holds the entry type, the rest of *sbp is zeroed
+ *        -1	type is not provided by the file system (DT_UNKNOWN)
+ */
+static int typeStat(int type, ino_t ino, struct stat *sbp)
+{
+#ifdef	DT_UNKNOWN
+	if (type == DT_UNKNOWN) return -1;
+	memset(sbp, 0, sizeof(struct stat));
+	sbp->st_mode = DTTOIF(type);
+	sbp->st_ino  = ino;
+	return 0;
+#else
+	return -1;
+#endif	/* DT_UNKNOWN */
+}
+
+/* d_type won't do for the entry, it has to be stat'ed */
+static int mustStat(dirWalk_t *wp, int type)
+{
+	if (wp->bTypeOnly == FALSE) return TRUE;
+#ifdef	DT_UNKNOWN
+	if (type == DT_UNKNOWN) return TRUE;
+	if (wp->bFollow && (type == DT_LNK)) return TRUE;	/* type of the target */
+	if ((wp->bOneFs || wp->bDevices) && wp->recursive && (type == DT_DIR)) return TRUE;	/* device of the sub-directory */
+	return FALSE;
+#else
+	return TRUE;
+#endif	/* DT_UNKNOWN */
+}
+
+/*
+ * Add a directory to the visited set
+ *
+ * Return:
+ *         1	added
+ *         0	visited already
+ *        -1	no memory (taken as not visited)
+ */
+static int visitedAdd(dirVisited_t *vp, dev_t dev, ino_t ino)
+{
+	int    rc = 1;
+	size_t ix;
+
+	if (vp->lock) pthread_mutex_lock(vp->lock);
+	if ((vp->count + 1) * 4 > vp->size * 3) {
+		/* keep the load under 3/4, rehash into twice the slots */
+		size_t       newSize = (vp->size) ? vp->size * 2 : 1024;
+		dirDevIno_t *newSlots = (dirDevIno_t *) calloc(newSize, sizeof(dirDevIno_t));
+		if (newSlots == NULL) {
+			if (vp->lock) pthread_mutex_unlock(vp->lock);
+			return -1;
+		}
+		for (ix = 0; ix < vp->size; ix++) {
+			dirDevIno_t *dp = &vp->slots[ix];
+			size_t       jx;
+			if (dp->ino == 0) continue;
+			jx = DEVINO_HASH(dp->dev, dp->ino) & (newSize - 1);
+			while (newSlots[jx].ino != 0) jx = (jx + 1) & (newSize - 1);
+			newSlots[jx] = *dp;
+		}
+		if (vp->slots) free(vp->slots);
+		vp->slots = newSlots;
+		vp->size  = newSize;
+	}
+
+	/* linear probing, inode 0 marks an empty slot */
+	if (ino == 0) ino = (ino_t) -1;
+	ix = DEVINO_HASH(dev, ino) & (vp->size - 1);
+	while (vp->slots[ix].ino != 0) {
+		if ((vp->slots[ix].ino == ino) && (vp->slots[ix].dev == dev)) {
+			rc = 0;
+			break;
+		}
+		ix = (ix + 1) & (vp->size - 1);
+	}
+	if (rc == 1) {
+		vp->slots[ix].dev = dev;
+		vp->slots[ix].ino = ino;
+		vp->count++;
+	}
+	if (vp->lock) pthread_mutex_unlock(vp->lock);
+	return rc;
+}
+
+/* release the slots of the visited set */
+static void visitedFree(dirVisited_t *vp)
+{
+	if (vp->slots) free(vp->slots);
+	vp->slots = NULL;
+	vp->size  = 0;
+	vp->count = 0;
+}
+
+/* short name of the entry type */
+static const char *modeString(mode_t mode)
+{
+	return	S_ISREG(mode)  ? "REG" :
+			S_ISDIR(mode)  ? "DIR" :
+			S_ISLNK(mode)  ? "LNK" :
+			S_ISSOCK(mode) ? "SOCK" :
+			"other";
+}
+#endif	/* !_MSC_VER */
+
+#ifdef	HAVE_STATX
+/* statx() mask for the stat fields needed (DIRINFO_NEED_xxx, 0 = all) */
+static unsigned statxMask(int needs)
+{
+	unsigned mask = STATX_TYPE | STATX_INO;
+
+	if (needs == 0) needs = DIRINFO_NEED_ALL;
+	if (needs & DIRINFO_NEED_SIZE)  mask |= STATX_SIZE | STATX_BLOCKS;
+	if (needs & DIRINFO_NEED_TIME)  mask |= STATX_MTIME | STATX_ATIME | STATX_CTIME;
+	if (needs & DIRINFO_NEED_MODE)  mask |= STATX_MODE;
+	if (needs & DIRINFO_NEED_OWNER) mask |= STATX_UID | STATX_GID;
+	if (needs & DIRINFO_NEED_BTIME) mask |= STATX_BTIME;
+	if (needs == DIRINFO_NEED_ALL)  mask |= STATX_BASIC_STATS;
+	return mask;
+}
+
+/* statx() an entry handle for the fields it needs, birth time as well if available
+ * (flags - AT_SYMLINK_NOFOLLOW or 0) */
+static int statxEntry(dirEntry_t *entp, int flags)
+{
+	struct statx stx;
+	int          rc;
+
+	rc = (int) syscall(SYS_statx, (entp->dirfd >= 0) ? entp->dirfd : AT_FDCWD,
+			(entp->dirfd >= 0) ? entp->name : entp->fullpath,
+			flags, statxMask(entp->needs), &stx);
+	if (rc != 0) return rc;
+	statxToStat(&stx, &entp->sb);
+	if (stx.stx_mask & STATX_BTIME) {
+		entp->hasBtime  = 1;
+		entp->btime     = (time_t) stx.stx_btime.tv_sec;
+		entp->btimeNsec = (long) stx.stx_btime.tv_nsec;
+	}
+	return 0;
+}
+
+/* struct stat out of the statx result */
+static void statxToStat(const struct statx *stxp, struct stat *sbp)
+{
+	memset(sbp, 0, sizeof(struct stat));
+	sbp->st_dev          = makedev(stxp->stx_dev_major, stxp->stx_dev_minor);
+	sbp->st_ino          = (ino_t) stxp->stx_ino;
+	sbp->st_mode         = (mode_t) stxp->stx_mode;
+	sbp->st_nlink        = (nlink_t) stxp->stx_nlink;
+	sbp->st_uid          = (uid_t) stxp->stx_uid;
+	sbp->st_gid          = (gid_t) stxp->stx_gid;
+	sbp->st_rdev         = makedev(stxp->stx_rdev_major, stxp->stx_rdev_minor);
+	sbp->st_size         = (off_t) stxp->stx_size;
+	sbp->st_blksize      = (blksize_t) stxp->stx_blksize;
+	sbp->st_blocks       = (blkcnt_t) stxp->stx_blocks;
+	sbp->st_atim.tv_sec  = stxp->stx_atime.tv_sec;
+	sbp->st_atim.tv_nsec = stxp->stx_atime.tv_nsec;
+	sbp->st_mtim.tv_sec  = stxp->stx_mtime.tv_sec;
+	sbp->st_mtim.tv_nsec = stxp->stx_mtime.tv_nsec;
+	sbp->st_ctim.tv_sec  = stxp->stx_ctime.tv_sec;
+	sbp->st_ctim.tv_nsec = stxp->stx_ctime.tv_nsec;
+}
+#endif	/* HAVE_STATX */
+
+/* path delimiter, a Unix shell on Windows takes "/" as well */
+static int pathDelimiter(void)
+{
+#ifdef	_MSC_VER
+	return (getenv("SHLVL") == NULL) ? '\\' : '/';
+#else	/* non-MSDOS */
+	return '/';
+#endif	/* _MSC_VER */
+}
+
+/*
+ * The traversal has to end: the cancellation token is set, or the deadline
+ * has passed (the clock is read every DIRINFO_DEADLINE_TICKS entries)
+ *
+ * Return: DIRINFO_CANCELLED, DIRINFO_TIMED_OUT or 0 to go on
+ */
+static int mustEnd(matchCriteria_t *mcbuf, unsigned *ticksp)
+{
+	if (mcbuf == NULL) return 0;
+	if (mcbuf->cancel && *mcbuf->cancel) return DIRINFO_CANCELLED;
+	if (mcbuf->deadline && ((*ticksp)++ % DIRINFO_DEADLINE_TICKS == 0) && (time(NULL) >= mcbuf->deadline)) {
+		return DIRINFO_TIMED_OUT;
+	}
+	return 0;
+}
+
+/*
+ * The criteria make a traversal possible: a getdents64() buffer holds at
+ * least one record of the longest name
+ *
+ * Return: 0 - fine, -1 - not (errno is EINVAL)
+ */
+static int checkCriteria(const char *dirname, matchCriteria_t *mcbuf)
+{
+	if (mcbuf && (mcbuf->direntBufSize != 0) && (mcbuf->direntBufSize < DIRINFO_DIRENT_MINSIZE)) {
+		if (mcbuf->printf)
+			mcbuf->printf(OUT_WARN, "%s: getdents64 buffer of %d bytes, less than %d\n", dirname, mcbuf->direntBufSize, DIRINFO_DIRENT_MINSIZE);
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+/* callback return code, unknown values are DIRINFO_CONTINUE */
+static int callbackAction(int rc)
+{
+	return ((rc == DIRINFO_SKIP_SUBTREE) || (rc == DIRINFO_STOP)) ? rc : DIRINFO_CONTINUE;
+}
+
+/* add an entry to the statistics, depth 0 = entries of the top directory */
+static void countEntry(dirInfo_t *dip, const struct stat *sbp, int depth, BOOL bSizes)
+{
+	if (S_ISDIR(sbp->st_mode)) dip->num_of_directories++;
+	else if (S_ISREG(sbp->st_mode)) dip->num_of_files++;
+	else dip->num_of_others++;
+
+	/* the stat buffer holds the size (DIRINFO_NEED_SIZE) */
+	if (bSizes == TRUE) {
+		dip->num_of_bytes  += (long long) sbp->st_size;
+#ifndef	_WIN32
+		dip->num_of_blocks += (long long) sbp->st_blocks;
+#endif	/* !_WIN32 */
+	}
+
+	if (depth < 0) depth = 0;
+	if (depth > dip->max_depth) dip->max_depth = depth;
+	dip->num_at_depth[(depth < DIRINFO_DEPTH_MAX) ? depth : DIRINFO_DEPTH_MAX - 1]++;
+}
+
+/* add up the statistics of a worker */
+static void addInfo(dirInfo_t *dip, const dirInfo_t *from)
+{
+	int depth;
+
+	dip->num_of_directories += from->num_of_directories;
+	dip->num_of_files       += from->num_of_files;
+	dip->num_of_others      += from->num_of_others;
+	dip->num_of_bytes       += from->num_of_bytes;
+	dip->num_of_blocks      += from->num_of_blocks;
+	if (from->max_depth > dip->max_depth) dip->max_depth = from->max_depth;
+	if (from->interrupted) dip->interrupted = from->interrupted;
+	if (from->threads) dip->threads = from->threads;
+	dip->errors += from->errors;
+	for (depth = 0; depth < DIRINFO_DEPTH_MAX; depth++) {
+		dip->num_at_depth[depth] += from->num_at_depth[depth];
+	}
+}
+
+#if	!defined(_WIN32) && !defined(__CYGWIN32__)
+/* stat an entry handle (flags - AT_SYMLINK_NOFOLLOW or 0) */
+static int entryStatAt(dirEntry_t *entp, int flags)
+{
+	int rc;
+
+#ifdef	HAVE_STATX
+	if (((rc = statxEntry(entp, flags)) != 0) && (errno == ENOSYS))	/* kernel before 4.11 */
+#endif	/* HAVE_STATX */
+	{
+		if (entp->dirfd >= 0)
+			rc = fstatat(entp->dirfd, entp->name, &entp->sb, flags);
+		else
+			rc = (flags & AT_SYMLINK_NOFOLLOW) ? lstat(entp->fullpath, &entp->sb) : stat(entp->fullpath, &entp->sb);
+	}
+	return rc;
+}
+#endif	/* !_WIN32 && !__CYGWIN32__ */
+
+/*
+ * Acquire the file status of an entry handle
+ *
+ * The stat call is made on first use only, the result is cached in the handle.
+ *
+ * Return:
+ *         pointer to the file status
+ *         NULL if the entry cannot be stat'ed
+ */
+struct stat *dirinfo_EntryStat(dirEntry_t *entp)
+{
+	if (entp->statDone == 0) {
+		int rc;
+#if	defined(_WIN32) || defined(__CYGWIN32__)
+		rc = stat(entp->fullpath, &entp->sb);
+#else
+		rc = entryStatAt(entp, entp->follow ? 0 : AT_SYMLINK_NOFOLLOW);
+		if ((rc != 0) && entp->follow && ((errno == ENOENT) || (errno == ELOOP))) {
+			/* dangling (or looping) symbolic link, the link itself */
+			rc = entryStatAt(entp, AT_SYMLINK_NOFOLLOW);
+		}
+#endif	/* _WIN32 || __CYGWIN32__ */
+		entp->statDone = (rc == 0) ? 1 : -1;
+	}
+	return (entp->statDone > 0) ? &entp->sb : NULL;
+}
+
+/*
+ * Type of an entry handle (S_IFMT bits of st_mode)
+ *
+ * The type reported by the directory entry is used if available,
+ * otherwise the entry is stat'ed.
+ *
+ * Return:
+ *         S_IFREG, S_IFDIR, ...
+ *         0 if the type cannot be determined
+ */
+int dirinfo_EntryType(dirEntry_t *entp)
+{
+	struct stat *statp;
+
+#ifdef	DT_UNKNOWN
+	if ((entp->statDone <= 0) && (entp->type != DT_UNKNOWN) &&
+		((entp->follow == 0) || (entp->type != DT_LNK)))
+		return DTTOIF(entp->type);
+#endif	/* DT_UNKNOWN */
+	if ((statp = dirinfo_EntryStat(entp)) == NULL)
+		return 0;
+	return (statp->st_mode & S_IFMT);
+}
+
+/*
+ * Time stamp of an entry handle (DIRINFO_MTIME, DIRINFO_ATIME, DIRINFO_CTIME, DIRINFO_BTIME)
+ *
+ * The entry is stat'ed if not yet.  Nanoseconds are zero where the
+ * platform keeps seconds only.  On Windows st_ctime is the creation time.
+ *
+ * Return:
+ *         0	*tsp holds the time stamp
+ *        -1	not available (stat failed, birth time not kept by the file system)
+ */
+int dirinfo_EntryTime(dirEntry_t *entp, int which, struct timespec *tsp)
+{
+	struct stat *statp;
+
+	if ((statp = dirinfo_EntryStat(entp)) == NULL)
+		return -1;
+	switch (which) {
+	case DIRINFO_MTIME:
+		tsp->tv_sec  = statp->st_mtime;
+		tsp->tv_nsec = STAT_NSEC(statp, m);
+		break;
+	case DIRINFO_ATIME:
+		tsp->tv_sec  = statp->st_atime;
+		tsp->tv_nsec = STAT_NSEC(statp, a);
+		break;
+	case DIRINFO_CTIME:
+		tsp->tv_sec  = statp->st_ctime;
+		tsp->tv_nsec = STAT_NSEC(statp, c);
+		break;
+	case DIRINFO_BTIME:
+#if	defined(_WIN32)
+		tsp->tv_sec  = statp->st_ctime;
+		tsp->tv_nsec = 0;
+#elif	defined(__APPLE__)
+		tsp->tv_sec  = statp->st_birthtimespec.tv_sec;
+		tsp->tv_nsec = statp->st_birthtimespec.tv_nsec;
+#else
+		if (entp->hasBtime == 0) return -1;
+		tsp->tv_sec  = entp->btime;
+		tsp->tv_nsec = entp->btimeNsec;
+#endif	/* _WIN32 */
+		break;
+	default:
+		return -1;
+	}
+	return 0;
+}
+
+/* public functions
+ */
+void dirinfo_Report(dirInfo_t *dip, char *name)
+{
+	fprintf(stdout, "# of %s directories %lld\n", name, dip->num_of_directories);
+	fprintf(stdout, "# of %s files       %lld\n", name, dip->num_of_files);
+	fprintf(stdout, "# of %s other types %lld\n", name, dip->num_of_others);
+}
+
+/*
+ * Report the statistics, sizes and entries per depth included
+ *
+ * - DIRINFO_REPORT_TEXT: dirinfo_Report() followed by the rest.
+ * - DIRINFO_REPORT_JSON: one object on a single line,
+ *   {"name":..,"directories":..,"files":..,"others":..,"bytes":..,"blocks":..,
+ *    "max_depth":..,"depths":[..]}, blocks in 512-byte units.
+ * - The workers of dirinfo_FindParallel() ("threads") are reported if known,
+ *   the directories not read in full ("errors") if any.
+ * - Bytes and blocks are 0 unless added up with DIRINFO_SIZES.  Entries
+ *   deeper than DIRINFO_DEPTH_MAX-1 are counted in the last depth.
+ */
+void dirinfo_ReportFormat(dirInfo_t *dip, const char *name, int format)
+{
+	int depth, maxDepth = (dip->max_depth < DIRINFO_DEPTH_MAX) ? dip->max_depth : DIRINFO_DEPTH_MAX - 1;
+
+	if (format == DIRINFO_REPORT_JSON) {
+		fprintf(stdout, "{\"name\":");
+		jsonString(name);
+		fprintf(stdout, ",\"directories\":%lld,\"files\":%lld,\"others\":%lld,\"bytes\":%lld,\"blocks\":%lld,\"max_depth\":%d,\"depths\":[",
+			dip->num_of_directories, dip->num_of_files, dip->num_of_others,
+			dip->num_of_bytes, dip->num_of_blocks, dip->max_depth);
+		for (depth = 0; depth <= maxDepth; depth++) {
+			fprintf(stdout, "%s%lld", depth ? "," : "", dip->num_at_depth[depth]);
+		}
+		fprintf(stdout, "]");
+		if (dip->interrupted) {
+			fprintf(stdout, ",\"interrupted\":\"%s\"", (dip->interrupted == DIRINFO_TIMED_OUT) ? "timed_out" : "cancelled");
+		}
+		if (dip->threads) {
+			fprintf(stdout, ",\"threads\":%d", dip->threads);
+		}
+		if (dip->errors) {
+			fprintf(stdout, ",\"errors\":%d", dip->errors);
+		}
+		fprintf(stdout, "}\n");
+		return;
+	}
+
+	dirinfo_Report(dip, (char *) name);
+	fprintf(stdout, "# of %s bytes       %lld\n", name, dip->num_of_bytes);
+	fprintf(stdout, "# of %s blocks      %lld (512 bytes)\n", name, dip->num_of_blocks);
+	fprintf(stdout, "max %s depth        %d\n", name, dip->max_depth);
+	for (depth = 0; depth <= maxDepth; depth++) {
+		fprintf(stdout, "  depth %2d%s %lld\n", depth, (depth == DIRINFO_DEPTH_MAX - 1) ? "+" : " ", dip->num_at_depth[depth]);
+	}
+	if (dip->threads) {
+		fprintf(stdout, "# of %s workers     %d\n", name, dip->threads);
+	}
+	if (dip->errors) {
+		fprintf(stdout, "# of %s errors      %d (directories not read in full)\n", name, dip->errors);
+	}
+	if (dip->interrupted) {
+		fprintf(stdout, "%s %s, partial counts\n", name, (dip->interrupted == DIRINFO_TIMED_OUT) ? "timed out" : "cancelled");
+	}
+}
+
+/*
+ * Print a JSON string: quotes, backslashes and control characters are
+ * escaped, and so is every byte not part of a valid UTF-8 sequence (as
+ * \u00XX, i.e. taken as Latin-1), pathnames being any bytes but NUL
+ */
+static void jsonString(const char *str)
+{
+	const unsigned char *cp = (const unsigned char *) str;
+	int len;
+
+	fputc('"', stdout);
+	while (*cp) {
+		if ((*cp == '"') || (*cp == '\\')) fprintf(stdout, "\\%c", *cp);
+		else if (*cp < 0x20) fprintf(stdout, "\\u%04x", *cp);
+		else if (*cp < 0x80) fputc(*cp, stdout);
+		else if ((len = utf8Length(cp)) > 0) {
+			fwrite(cp, 1, len, stdout);
+			cp += len;
+			continue;
+		}
+		else fprintf(stdout, "\\u%04x", *cp);
+		cp++;
+	}
+	fputc('"', stdout);
+}
+
+/* length of the valid UTF-8 sequence of a non-ASCII character, 0 if none */
+static int utf8Length(const unsigned char *cp)
+{
+	int len, ix;
+	unsigned char lo = 0x80, hi = 0xbf;		/* range of the second byte */
+
+	if ((cp[0] >= 0xc2) && (cp[0] <= 0xdf)) len = 2;
+	else if ((cp[0] >= 0xe0) && (cp[0] <= 0xef)) {
+		len = 3;
+		if (cp[0] == 0xe0) lo = 0xa0;		/* overlong */
+		if (cp[0] == 0xed) hi = 0x9f;		/* surrogates */
+	}
+	else if ((cp[0] >= 0xf0) && (cp[0] <= 0xf4)) {
+		len = 4;
+		if (cp[0] == 0xf0) lo = 0x90;		/* overlong */
+		if (cp[0] == 0xf4) hi = 0x8f;		/* beyond U+10FFFF */
+	}
+	else return 0;
+
+	if ((cp[1] < lo) || (cp[1] > hi)) return 0;
+	for (ix = 2; ix < len; ix++) {
+		if ((cp[ix] < 0x80) || (cp[ix] > 0xbf)) return 0;
+	}
+	return len;
 }
 
 /* ***********************************
@@ -51,6 +51,60 @@ extern "C" {
  */
 typedef int (*FILEPROC)(const char *filename, const char *fullpath, struct stat *statp, void *opaquep);
 typedef int (*OutputFunc)(const int level, const char *format, ...);
+	/* entry handle for ENTRYPROC callbacks
+	 * - name, fullpath, type and dirfd are filled in by dirinfo
+	 * - use dirinfo_EntryStat() & dirinfo_EntryType() to access the file status,
+	 *   the stat call is made on first use only and cached in the handle
+	 */
+typedef struct dirEntry {
+		const char  *name;		/* entry name */
+		const char  *fullpath;	/* full pathname */
+		int          nameLen;	/* strlen(name) */
+		int          pathLen;	/* strlen(fullpath) */
+		int          type;		/* d_type of the directory entry (DT_xxx, 0 = unknown) */
+		int          dirfd;		/* parent directory fd (-1 = use fullpath) */
+		/* private */
+		int          statDone;	/* 0 = not yet, 1 = sb is valid, -1 = stat failed */
+		int          needs;		/* stat fields to acquire (DIRINFO_NEED_xxx, 0 = all) */
+		int          follow;	/* stat the target of a symbolic link */
+		int          hasBtime;	/* btime is valid */
+		time_t       btime;		/* birth time, use dirinfo_EntryTime() */
+		long         btimeNsec;
+		struct stat  sb;
+} dirEntry_t;
+typedef int (*ENTRYPROC)(dirEntry_t *entp, void *opaquep);
+	/* directory batch for BATCHPROC callbacks, entries 0 .. count-1 in arrays
+	 * - the names are in one buffer, NUL-terminated, at names + nameOff[i]
+	 * - mode (type & permission bits), size & mtime are stat'ed for
+	 *   matchCriteria_t.needs, they are zero for fields not asked for
+	 * - set action[i] to DIRINFO_SKIP_SUBTREE not to descend into entry i
+	 * - the arrays are valid while the callback runs
+	 * - only the fd-relative walk builds batches: setting batchProc selects it
+	 *   (DIRINFO_FDRELATIVE is implied), on _MSC_VER batchProc is never called
+	 */
+typedef struct dirBatch {
+		const char      *dirpath;	/* the directory */
+		int              dirfd;		/* its descriptor (-1 = use dirpath) */
+		int              level;		/* level of the directory */
+		int              count;		/* # of entries */
+		const char      *names;
+		unsigned        *nameOff;
+		unsigned short  *nameLen;
+		unsigned char   *type;		/* DT_xxx, from the file status if stat'ed (0 = unknown) */
+		mode_t          *mode;
+		off_t           *size;
+		time_t          *mtime;
+		unsigned char   *action;	/* DIRINFO_CONTINUE, set by the callback */
+} dirBatch_t;
+typedef int (*BATCHPROC)(dirBatch_t *bp, void *opaquep);
+
+/* callback return codes (proc, entryProc, batchProc, postFunc)
+ * - any other value is taken as DIRINFO_CONTINUE
+ * - DIRINFO_SKIP_SUBTREE from batchProc: none of the sub-directories of the batch
+ */
+#define	DIRINFO_CONTINUE		0	/* go on */
+#define	DIRINFO_SKIP_SUBTREE	1	/* do not descend into this directory entry */
+#define	DIRINFO_STOP			2	/* end the traversal, no more callbacks (postFunc included) */
 // typedef void (*VOIDPROC)(int);
 // typedef int  (*FINTPROC)(FILE *, void *);
 // typedef int  (*Mon_OutputFunc)(const ui8 * str, ...);
@@ -58,10 +112,19 @@ typedef int (*OutputFunc)(const int level, const char *format, ...);
 /*
  * dirinfo
  * */
+#define	DIRINFO_DEPTH_MAX	32	/* depths counted apart, deeper ones go to the last */
+
 typedef struct dirInfo {
-        int  num_of_directories;
-        int  num_of_files;
-        int  num_of_others;
+        long long  num_of_directories;
+        long long  num_of_files;
+        long long  num_of_others;
+        long long  num_of_bytes;		/* apparent size, st_size (DIRINFO_SIZES) */
+        long long  num_of_blocks;		/* allocated 512-byte blocks, st_blocks (DIRINFO_SIZES) */
+        int        max_depth;			/* deepest entry, 0 = entries of the top directory */
+        long long  num_at_depth[DIRINFO_DEPTH_MAX];	/* entries per depth */
+        int        interrupted;		/* cut short: DIRINFO_CANCELLED or DIRINFO_TIMED_OUT (0 - no) */
+        int        threads;			/* dirinfo_FindParallel: workers at the end (0 - not parallel) */
+        int        errors;			/* directories not read in full: no memory or descriptors, read errors */
 } dirInfo_t;
 typedef struct matchCriteria {
 		int      type;		/* NO predefined constants for this field */
@@ -72,17 +135,120 @@ typedef struct matchCriteria {
 		} cparam;
 		/* information to be carried along to every entry */
 		FILEPROC	proc;		// callback for every directory entries
+		ENTRYPROC	entryProc;	// callback for every directory entries (lazy stat)
+		BATCHPROC	batchProc;	// callback for all entries of a directory at once, before the ones above
 		FILEPROC	postFunc;	// callback after all directory entries were visited
 		OutputFunc	printf;		// output function (e.g. printf)
 		void		*iblock;	// embedded other information
+		int		flags;		// traversal mode (DIRINFO_xxx)
+		int		needs;		// stat fields used by the callback (DIRINFO_NEED_xxx, 0 = all)
+		int		direntBufSize;	// getdents64 buffer size of the top level (0 = DIRINFO_DIRENT_BUFSIZE, at least DIRINFO_DIRENT_MINSIZE)
+		int		frontierMax;	// max directories queued in DIRINFO_BFS mode (0 = DIRINFO_FRONTIER_MAX)
+		int		chunkSize;		// entries stat'ed by a worker at a time in DIRINFO_CHUNKS mode (0 = DIRINFO_CHUNK_SIZE)
+		int		deviceMax;		// dirinfo_FindParallel: workers on one device (st_dev) at a time (0 = no limit)
+		int		prefetchMax;	// DIRINFO_ORDERED: directories read ahead of the callbacks (0 = as memory allows)
+		long	prefetchMem;	// DIRINFO_ORDERED: bytes of entries read ahead (0 = DIRINFO_PREFETCH_MEM)
+		volatile sig_atomic_t *cancel;	// cancellation token, the traversal winds down once set (NULL - none)
+		time_t	deadline;		// wall clock time to wind down at (0 - none)
 } matchCriteria_t;
 
+/* why a traversal was cut short (dirInfo_t.interrupted)
+ * - the cancellation token & the deadline are checked between entries, by every worker
+ * - directories still open are closed, postFunc is not called any more
+ * - the statistics cover the entries visited so far
+ */
+#define	DIRINFO_CANCELLED	1	/* *matchCriteria_t.cancel was set */
+#define	DIRINFO_TIMED_OUT	2	/* matchCriteria_t.deadline has passed */
+
+/* traversal context (dirinfo_CtxInit, dirinfo_CtxFind, dirinfo_CtxFree)
+ * - everything a traversal needs is in the context, dirinfo keeps no state
+ *   of its own, so traversals in different threads need one context each
+ * - callbacks get &ctx->mc as their opaque pointer
+ * - buffers are kept between traversals made with the same context
+ */
+typedef struct dirinfo_Ctx {
+		matchCriteria_t mc;			// callbacks & traversal mode
+		int		recursive;			// recursive flag
+		int		maxLevel;			// max recursive level (0 - unlimited)
+		int		threads;			// dirinfo_FindParallel() workers (0, 1 - dirinfo_Find)
+		dirInfo_t	stats;			// statistics, added up over the traversals
+		/* private */
+		void	*buffers;			// kept by dirinfo_CtxFind(), freed by dirinfo_CtxFree()
+} dirinfo_Ctx;
+
+/* traversal mode (matchCriteria_t.flags)
+ */
+#define	DIRINFO_FDRELATIVE	0x0001	/* walk with openat()/fstatat() relative to the parent directory (non-Windows) */
+#define	DIRINFO_GETDENTS	0x0002	/* read directories with getdents64() in bulk (Linux, implies DIRINFO_FDRELATIVE) */
+#define	DIRINFO_SERIALIZE	0x0004	/* dirinfo_FindParallel: one callback at a time (callbacks are not thread-safe) */
+#define	DIRINFO_BFS			0x0008	/* breadth first, shallow entries first (with DIRINFO_FDRELATIVE, not dirinfo_FindParallel) */
+#define	DIRINFO_URING		0x0010	/* stat & open entries in batches through io_uring (Linux, with DIRINFO_FDRELATIVE) */
+#define	DIRINFO_PRESTAT		0x0020	/* entryProc: stat every entry before the callback instead of on demand */
+#define	DIRINFO_INODE_ORDER	0x0040	/* stat the entries of a directory in inode order ahead of the callbacks,
+									 * which still come in directory order (with DIRINFO_FDRELATIVE, implies DIRINFO_PRESTAT) */
+#define	DIRINFO_FOLLOW		0x0080	/* follow symbolic links, every directory is read once (with DIRINFO_FDRELATIVE) */
+#define	DIRINFO_ONE_FS		0x0100	/* stay on the file system of the top directory, mount points are not entered */
+#define	DIRINFO_SIZES		0x0200	/* dirInfo_t: add up bytes & blocks (every entry is stat'ed for DIRINFO_NEED_SIZE) */
+#define	DIRINFO_ORDERED		0x0400	/* dirinfo_FindParallel: callbacks in the depth first order of dirinfo_Find(),
+									 * the workers read directories ahead (the default is as found, the fastest) */
+#define	DIRINFO_CHUNKS		0x0800	/* dirinfo_FindParallel: past chunkSize entries, the rest of a directory is read as a whole
+									 * and stat'ed in chunks by the idle workers, callbacks still come in directory order */
+#define	DIRINFO_FS_POLICY	0x1000	/* tune the traversal to the file system type of each mount (Linux, with DIRINFO_FDRELATIVE):
+									 * pseudo file systems (/proc, /sys, ...) below the top directory are not entered,
+									 * d_type is not trusted on FUSE, ext2/3/4 is stat'ed in inode order,
+									 * DIRINFO_CHUNKS splits network file systems in smaller chunks, tmpfs not at all */
+#define	DIRINFO_ADAPTIVE	0x2000	/* dirinfo_FindParallel: <threads> is the most, the workers at work are tuned
+									 * as it goes to the number visiting the most entries per second */
+
+#define	DIRINFO_DIRENT_BUFSIZE	(1024*1024)	/* default getdents64 buffer of the top level, halved per depth down to 32k */
+#define	DIRINFO_DIRENT_MINSIZE	512			/* smallest getdents64 buffer, one record of the longest name */
+#define	DIRINFO_FRONTIER_MAX	65536		/* default breadth-first frontier, deeper levels go depth first beyond */
+#define	DIRINFO_CHUNK_SIZE		4096		/* default chunk, directories with fewer entries are not split */
+#define	DIRINFO_PREFETCH_MEM	(16*1024*1024)	/* default memory of the entries read ahead (DIRINFO_ORDERED) */
+
+/* stat fields the callback uses (matchCriteria_t.needs)
+ *
+ * When only DIRINFO_NEED_TYPE is requested, the entry type is taken from
+ * the directory entry (d_type) and the stat call is skipped unless the
+ * file system does not report it.  Other fields of the stat buffer are zero.
+ * On Linux the mask is passed on to statx(), so that e.g. network file
+ * systems need not refresh attributes nobody looks at.
+ */
+#define	DIRINFO_NEED_TYPE	0x0001	/* st_mode & S_IFMT */
+#define	DIRINFO_NEED_SIZE	0x0002	/* st_size, st_blocks */
+#define	DIRINFO_NEED_TIME	0x0004	/* st_mtime, st_atime, st_ctime */
+#define	DIRINFO_NEED_MODE	0x0008	/* permission bits */
+#define	DIRINFO_NEED_OWNER	0x0010	/* st_uid, st_gid */
+#define	DIRINFO_NEED_BTIME	0x0020	/* birth time (dirinfo_EntryTime) */
+#define	DIRINFO_NEED_ALL	0x00ff
+
+/* time stamps for dirinfo_EntryTime()
+ */
+#define	DIRINFO_MTIME		0	/* last modification */
+#define	DIRINFO_ATIME		1	/* last access */
+#define	DIRINFO_CTIME		2	/* last status change */
+#define	DIRINFO_BTIME		3	/* creation (birth), not on every file system */
+
+
+/* dirinfo_ReportFormat() output
+ */
+#define	DIRINFO_REPORT_TEXT	0	/* for humans */
+#define	DIRINFO_REPORT_JSON	1	/* one JSON object per line, for monitoring jobs */
+
 
 /* public functions
  */
 	///TODO: maxLevel > 1 implies recursive == 1
 extern int dirinfo_Find(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel);
+extern int dirinfo_FindParallel(const char *dirname, dirInfo_t *dip, matchCriteria_t *mcbuf, int recursive, int maxLevel, int curLevel, int threads);
+extern void dirinfo_CtxInit(dirinfo_Ctx *ctx);
+extern int dirinfo_CtxFind(dirinfo_Ctx *ctx, const char *dirname);
+extern void dirinfo_CtxFree(dirinfo_Ctx *ctx);
 extern void dirinfo_Report(dirInfo_t *dip, char *name);
+extern void dirinfo_ReportFormat(dirInfo_t *dip, const char *name, int format);
+extern struct stat *dirinfo_EntryStat(dirEntry_t *entp);
+extern int dirinfo_EntryType(dirEntry_t *entp);
+extern int dirinfo_EntryTime(dirEntry_t *entp, int which, struct timespec *tsp);
 extern int IsValidPath(const char *path);
 extern int IsDirectory(const char *path);
 extern int IsFile(const char *path);
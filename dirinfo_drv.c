@@ -24,6 +24,7 @@
 #if	defined(unix) || defined(__STDC__)
 #include <dirent.h>
 #include <unistd.h>
+#include <sys/time.h>
 #endif
 
 #include "dirinfo.h"
@@ -41,7 +42,9 @@ int gDebug = 0;
 
 /* local functions
  */
-static void show_dirinfo(char *dirpath, int recursive);
+static int show_dirinfo(char *dirpath, int recursive, int format);
+static void benchmark(char *dirpath, int recursive);
+static int check_batch(char *dirpath, int recursive);
 
 
 // typedef int (*FILEPROC)(char *, char *, struct stat *, void *);
@@ -98,6 +101,61 @@ int compareTime(const char *filename, const char *dirname, struct stat *statp, v
 	return rc;
 }
 
+// callback that wants the complete file status
+int statEntry(const char *filename, const char *dirname, struct stat *statp, void *voidp)
+{
+	return 0;
+}
+
+// batch callback that looks at the file status of the whole directory
+int statBatch(dirBatch_t *bp, void *voidp)
+{
+	return 0;
+}
+
+/* batchProc vs. proc consistency check: entries & an order-free sum of them */
+typedef struct batchCheck {
+	long long          count;
+	unsigned long long sum;
+} batchCheck_t;
+
+static unsigned long long checkHash(const char *name, mode_t mode, off_t size, time_t mtime)
+{
+	unsigned long long h = 14695981039346656037ULL;	/* FNV-1a */
+
+	while (*name) {
+		h ^= (unsigned char) *name++;
+		h *= 1099511628211ULL;
+	}
+	h ^= (unsigned long long) mode;  h *= 1099511628211ULL;
+	h ^= (unsigned long long) size;  h *= 1099511628211ULL;
+	h ^= (unsigned long long) mtime; h *= 1099511628211ULL;
+	return h;
+}
+
+// add this entry to the per-entry side of the check
+int checkEntry(const char *filename, const char *dirname, struct stat *statp, void *voidp)
+{
+	batchCheck_t *cp = (batchCheck_t *) ((matchCriteria_t *) voidp)->iblock;
+
+	cp->count++;
+	cp->sum += checkHash(filename, statp->st_mode, statp->st_size, statp->st_mtime);
+	return 0;
+}
+
+// add the entries of this directory to the batch side of the check
+int checkBatch(dirBatch_t *bp, void *voidp)
+{
+	batchCheck_t *cp = (batchCheck_t *) ((matchCriteria_t *) voidp)->iblock;
+	int ix;
+
+	for (ix = 0; ix < bp->count; ix++) {
+		cp->count++;
+		cp->sum += checkHash(bp->names + bp->nameOff[ix], bp->mode[ix], bp->size[ix], bp->mtime[ix]);
+	}
+	return 0;
+}
+
 // print this entry if it is a File
 int showFileEntry(const char *filename, const char *dirname, struct stat *statp, void *voidp)
 {
@@ -154,13 +212,31 @@ main(int argc, char **argv)
 			showVersion(argv[0]);
 			return 0;
 		}
+		else if ((strncmp(argv[1], "-b", 2)) == 0) {
+			/* benchmark only */
+			if (argc > 2) benchmark(argv[2], 1);
+			return 0;
+		}
+		else if ((strncmp(argv[1], "-c", 2)) == 0) {
+			/* batch callback check only */
+			return (argc > 2) ? check_batch(argv[2], 1) : -1;
+		}
+		else if (((strncmp(argv[1], "-l", 2)) == 0) || ((strncmp(argv[1], "-j", 2)) == 0)) {
+			/* report only (JSON for monitoring jobs) */
+			int format = (argv[1][1] == 'j') ? DIRINFO_REPORT_JSON : DIRINFO_REPORT_TEXT;
+			int ix, rc = (argc > 2) ? 0 : -1;
+			for (ix = 2; ix < argc; ix++) {
+				if (show_dirinfo(argv[ix], 1, format) != 0) rc = -2;	/* not a directory */
+			}
+			return rc;
+		}
 		else { /* unrecognized option */
 			break;
 		}
 	}	/* while (argc > 1) */
 
 	if (argc <= 1) {
-		fprintf(stderr, "usage: %s _directory_\n", argv[0]);
+		fprintf(stderr, "usage: %s [-d#] [-b|-c|-l|-j] _directory_ ...\n", argv[0]);
 		return -1;
 	}
 
@@ -176,7 +252,7 @@ main(int argc, char **argv)
 	loop = 1;
 	recursive = 1;
 	do {
-		static char *prompt = "[l|F|D|b|e|c|n|o|r|d|R|x]";
+		static char *prompt = "[l|F|D|b|e|c|n|o|r|d|R|B|x]";
 		char ans[80];
 
 		//fprintf(stderr, "-2-resource=%c (0x%02x)\n", resource, (int)resource);
@@ -210,6 +286,7 @@ main(int argc, char **argv)
 				fprintf(stderr, " r - change root directory\n");
 				fprintf(stderr, " d - change debug level\n");
 				fprintf(stderr, " R - toggle recursive\n");
+				fprintf(stderr, " B - benchmark traversal engines\n");
 				fprintf(stderr, " x - quit\n");
 				}
 				break;
@@ -304,7 +381,14 @@ main(int argc, char **argv)
 
 			case 'l':	/* show directory information */
 				{
-				show_dirinfo(destdirp, recursive);
+				show_dirinfo(destdirp, recursive, DIRINFO_REPORT_TEXT);
+				}
+				break;
+
+			case 'B':	/* benchmark traversal engines */
+				{
+				benchmark(destdirp, recursive);
+				check_batch(destdirp, recursive);
 				}
 				break;
 
@@ -354,14 +438,14 @@ main(int argc, char **argv)
 	return 0;
 }
 
-static void show_dirinfo(char *dirpath, int recursive)
+/*
+ * Report the directory, nothing if it cannot be read (return -1)
+ */
+static int show_dirinfo(char *dirpath, int recursive, int format)
 {
-	dirInfo_t dibuf = { 0 };
+	dirinfo_Ctx ctx;
 	char  path[80];
 	char  *pathp = &path[0];
-	//
-	int maxLevel = 0;	// set to fixed value for testing purpose
-	int curLevel = 0;	// set to fixed value for testing purpose
 
 	if (dirpath == NULL) {
 		printf("destination dir: ");
@@ -371,10 +455,128 @@ static void show_dirinfo(char *dirpath, int recursive)
 		pathp = dirpath;
 	}
 
-	/* search directory info */
-	dirinfo_Find(pathp, &dibuf, NULL, recursive, maxLevel, curLevel);
+	/* search directory info, sizes are added up in the same pass */
+	dirinfo_CtxInit(&ctx);
+	ctx.recursive = recursive;
+	ctx.maxLevel  = 0;		// unlimited
+	ctx.mc.flags  = DIRINFO_SIZES;
+#ifndef	_MSC_VER
+	ctx.mc.flags |= DIRINFO_FDRELATIVE;
+#endif	/* !_MSC_VER */
+#ifdef	__linux__
+	ctx.mc.flags |= DIRINFO_GETDENTS;
+#endif	/* __linux__ */
+	ctx.mc.needs = DIRINFO_NEED_TYPE | DIRINFO_NEED_SIZE;
+	if (dirinfo_CtxFind(&ctx, pathp) < 0) {
+		fprintf(stderr, "%s: error opening directory\n", pathp);
+		dirinfo_CtxFree(&ctx);
+		return -1;
+	}
 
 	/* closing report */
-	dirinfo_Report(&dibuf, dirpath);
+	dirinfo_ReportFormat(&ctx.stats, pathp, format);
+	dirinfo_CtxFree(&ctx);
+	return 0;
+}
+
+/* wall clock in milliseconds */
+static double msecNow(void)
+{
+#ifdef	_MSC_VER
+	return (double) GetTickCount();
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000.0) + (tv.tv_usec / 1000.0);
+#endif	/* _MSC_VER */
+}
+
+/*
+ * Traverse the directory with every engine, a few passes each
+ *
+ * The callback wants the complete file status, so every entry is stat'ed.
+ * The first pass may run on a cold cache (drop the page cache beforehand,
+ * e.g. echo 3 > /proc/sys/vm/drop_caches, to compare cold caches).
+ */
+static void benchmark(char *dirpath, int recursive)
+{
+	static struct {
+		char *name;
+		int   flags;
+		int   batch;		/* one callback per directory */
+	} engines[] = {
+		{ "readdir + lstat",       0, 0 },
+#ifndef	_MSC_VER
+		{ "openat + fstatat",      DIRINFO_FDRELATIVE, 0 },
+#endif	/* !_MSC_VER */
+#ifdef	__linux__
+		{ "getdents64 + fstatat",  DIRINFO_GETDENTS, 0 },
+		{ "getdents64 + inode order", DIRINFO_GETDENTS | DIRINFO_INODE_ORDER, 0 },
+		{ "getdents64 + io_uring", DIRINFO_GETDENTS | DIRINFO_URING, 0 },
+		{ "getdents64 + batch",    DIRINFO_GETDENTS, 1 },
+#endif	/* __linux__ */
+	};
+	int engine, pass;
+
+	fprintf(stderr, "benchmark: %s (%s)\n", dirpath, recursive ? "recursive" : "non-recursive");
+	for (engine = 0; engine < (int) (sizeof(engines) / sizeof(engines[0])); engine++) {
+		fprintf(stderr, "  %-26s", engines[engine].name);
+		for (pass = 0; pass < 3; pass++) {
+			dirInfo_t       dibuf = { 0 };
+			matchCriteria_t mcbuf = { 0 };
+			double          msec;
+
+			if (engines[engine].batch) {
+				mcbuf.batchProc = statBatch;
+				mcbuf.needs     = DIRINFO_NEED_TYPE | DIRINFO_NEED_SIZE | DIRINFO_NEED_MODE;
+			}
+			else mcbuf.proc = statEntry;
+			mcbuf.flags = engines[engine].flags;
+			msec = msecNow();
+			dirinfo_Find(dirpath, &dibuf, &mcbuf, recursive, 0, 0);
+			msec = msecNow() - msec;
+			fprintf(stderr, " %9.2f ms", msec);
+			if (pass == 2) {
+				fprintf(stderr, "  (%lld entries)\n", dibuf.num_of_directories + dibuf.num_of_files + dibuf.num_of_others);
+			}
+		}
+	}
 }
 
+/*
+ * Check that batchProc sees what proc sees: the same entries with the same
+ * mode, size & mtime (return -1 if not)
+ *
+ * The tree should not change while it runs, it is traversed twice.
+ */
+static int check_batch(char *dirpath, int recursive)
+{
+	batchCheck_t check[2];
+	int pass;
+
+	memset(check, 0, sizeof(check));
+	for (pass = 0; pass < 2; pass++) {
+		dirInfo_t       dibuf = { 0 };
+		matchCriteria_t mcbuf = { 0 };
+
+		if (pass) {
+			mcbuf.batchProc = checkBatch;
+			mcbuf.needs     = DIRINFO_NEED_TYPE | DIRINFO_NEED_SIZE | DIRINFO_NEED_TIME | DIRINFO_NEED_MODE;
+		}
+		else mcbuf.proc = checkEntry;
+#ifndef	_MSC_VER
+		mcbuf.flags  = DIRINFO_FDRELATIVE;	/* the only walk with batchProc */
+#endif	/* !_MSC_VER */
+		mcbuf.iblock = &check[pass];
+		if (dirinfo_Find(dirpath, &dibuf, &mcbuf, recursive, 0, 0) < 0) {
+			fprintf(stderr, "%s: error opening directory\n", dirpath);
+			return -1;
+		}
+	}
+	if ((check[0].count != check[1].count) || (check[0].sum != check[1].sum)) {
+		fprintf(stderr, "batch check: %s: MISMATCH, %lld entries per entry, %lld in batches\n", dirpath, check[0].count, check[1].count);
+		return -1;
+	}
+	fprintf(stderr, "batch check: %s: %lld entries, batches match\n", dirpath, check[0].count);
+	return 0;
+}